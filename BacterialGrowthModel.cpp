@@ -5,7 +5,22 @@
 #include <chrono>
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <nlohmann/json.hpp> // JSON 库
+#include "ThreadPool.h"
+#include "Philox.h"
+#include "TimeSeriesSink.h"
 
 using json = nlohmann::json;
 
@@ -14,13 +29,30 @@ const int DEFAULT_INITIAL_POPULATION = 10;
 const double DEFAULT_GROWTH_RATE = 0.3;
 const double DEFAULT_DEATH_RATE = 0.1;
 const double DEFAULT_RESOURCE_LIMIT = 20;
+const std::uint64_t DEFAULT_SEED = 20240601;
+const int TILE_SIZE = 64; // 分块边长：每块作为一个并行任务
+const std::uint64_t INITIAL_STREAM = ~0ull; // 初始分布使用的随机序列，与各时间步区分
 
-class Cell {
-public:
-    int population;
-    double resources;
+// 每个时间步的事件模型：
+// PerCell     每个单元至多一次出生、一次死亡（原模型）
+// PerOrganism 每个个体独立地以 growthRate / deathRate 繁殖或死亡，每个单元各抽一次二项分布；
+//             每次出生消耗一份资源，出生数不超过单元现有资源，种群每步至多增加 DEFAULT_RESOURCE_LIMIT
+enum class EventMode { PerCell, PerOrganism };
+
+// 连续存储的网格（结构数组）：种群数与资源量各占一段连续内存，行优先排列
+struct BacteriaGrid {
+    int size = 0;
+    std::vector<int> population;
+    std::vector<float> resources; // 资源只按整数增减，float 可以精确表示且内存流量减半
 
-    Cell() : population(0), resources(DEFAULT_RESOURCE_LIMIT) {}
+    void reset(int newSize) {
+        size = newSize;
+        const std::size_t cells = static_cast<std::size_t>(size) * size;
+        population.assign(cells, 0);
+        resources.assign(cells, static_cast<float>(DEFAULT_RESOURCE_LIMIT));
+    }
+
+    std::size_t index(int x, int y) const { return static_cast<std::size_t>(x) * size + y; }
 };
 
 class EnvironmentalFactors {
@@ -33,95 +65,511 @@ public:
         : temperature(temp), pH(pHVal), nutrientConcentration(nutrient) {}
 };
 
+double adjustGrowthRate(double growthRate, const EnvironmentalFactors& envFactors) {
+    // 这里可以添加基于实际生物学数据调整的逻辑
+    return growthRate * (1 + 0.1 * (envFactors.temperature - 25)) * (1 - fabs(envFactors.pH - 7) / 14) *
+           (envFactors.nutrientConcentration / 10);
+}
+
+// 把 count 个初始个体随机撒到网格上；随机数由 Philox(seed, 初始序列, 个体编号) 给出
+void seedPopulation(BacteriaGrid& grid, int count, std::uint64_t seed) {
+    for (int i = 0; i < count; ++i) {
+        PhiloxRNG rng(seed, INITIAL_STREAM, static_cast<std::uint32_t>(i));
+        int x = static_cast<int>((static_cast<std::uint64_t>(rng.nextUInt()) * grid.size) >> 32);
+        int y = static_cast<int>((static_cast<std::uint64_t>(rng.nextUInt()) * grid.size) >> 32);
+        grid.population[grid.index(x, y)]++;
+    }
+}
+
 class BacterialGrowthModel {
 public:
-    BacterialGrowthModel(int gridSize, int initialPopulation, double growthRate, double deathRate, const EnvironmentalFactors& envFactors)
-        : gridSize(gridSize), initialPopulation(initialPopulation), growthRate(growthRate), deathRate(deathRate), envFactors(envFactors) {
-        grid.resize(gridSize, std::vector<Cell>(gridSize));
-        initializePopulation();
-        generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
-    }
-
-    void simulate(int timeSteps) {
-        std::ofstream logFile("simulation_log.txt");
-        std::ofstream csvFile("simulation_data.csv");
-        csvFile << "Time,Avg Population\n";
-        
-        for (int t = 0; t < timeSteps; ++t) {
-            updatePopulation();
-            double avgPopulation = outputAveragePopulation();
-            csvFile << t << "," << avgPopulation << "\n";
-            logFile << "Time: " << t << ", Avg Population: " << avgPopulation << "\n";
-            distributeResources();
+    BacterialGrowthModel(int gridSize, int initialPopulation, double growthRate, double deathRate, const EnvironmentalFactors& envFactors,
+                         unsigned threads = std::thread::hardware_concurrency(), std::uint64_t seed = DEFAULT_SEED,
+                         EventMode eventMode = EventMode::PerCell)
+        : gridSize(gridSize), pool(threads) {
+        tilesPerSide = (gridSize + TILE_SIZE - 1) / TILE_SIZE;
+        reset(initialPopulation, growthRate, deathRate, envFactors, seed, eventMode);
+    }
+
+    // 以新的参数与种子从头开始模拟。网格大小不变，网格与分块数组沿用已分配的内存，
+    // 集合模拟中同一线程的各次运行不再重复分配
+    void reset(int initialPopulation, double growthRate, double deathRate, const EnvironmentalFactors& envFactors,
+               std::uint64_t seed, EventMode eventMode) {
+        this->initialPopulation = initialPopulation;
+        this->growthRate = growthRate;
+        this->envFactors = envFactors;
+        this->seed = seed;
+        this->eventMode = eventMode;
+        stepIndex = 0;
+        // 生长率只取决于环境参数，每次运行计算一次；概率必须在 [0, 1] 内
+        effectiveGrowthRate = std::min(std::max(adjustGrowthRate(growthRate, envFactors), 0.0), 1.0);
+        this->deathRate = std::min(std::max(deathRate, 0.0), 1.0);
+        birthThreshold = probabilityThreshold(effectiveGrowthRate);
+        deathThreshold = probabilityThreshold(this->deathRate);
+        grid.reset(gridSize);
+        tilePopulation.assign(static_cast<std::size_t>(tilesPerSide) * tilesPerSide, 0);
+        seedPopulation(grid, initialPopulation, seed);
+
+        // 空单元只有在不会自发出生时才保持空闲：逐个体模式，或逐单元模式下生长率为 0
+        sparse = eventMode == EventMode::PerOrganism || birthThreshold == 0;
+        activeTiles.clear();
+        for (std::size_t tile = 0; tile < tilePopulation.size(); ++tile) {
+            if (!sparse || !tileIdle(tile)) activeTiles.push_back(static_cast<std::uint32_t>(tile));
         }
+    }
 
-        logFile.close();
-        csvFile.close();
+    // 推进一个时间步，返回更新后的平均种群数。只处理活跃块；空闲块（所有单元无个体且资源已满）
+    // 之后不会再发生任何变化，直接从活跃列表中移除，因此耗时与菌落面积而不是网格面积成正比
+    double step() {
+        tileKeep.resize(activeTiles.size());
+        pool.parallelFor(0, activeTiles.size(), 1, [this](std::size_t begin, std::size_t end) {
+            for (std::size_t a = begin; a < end; ++a) {
+                tileKeep[a] = stepTile(activeTiles[a]) || !sparse;
+            }
+        });
+        // 按块的固定顺序求和，结果与线程数无关
+        long long totalPopulation = 0;
+        std::size_t kept = 0;
+        for (std::size_t a = 0; a < activeTiles.size(); ++a) {
+            totalPopulation += tilePopulation[activeTiles[a]];
+            if (tileKeep[a]) activeTiles[kept++] = activeTiles[a];
+        }
+        activeTiles.resize(kept);
+        ++stepIndex;
+        return static_cast<double>(totalPopulation) / (static_cast<double>(gridSize) * gridSize);
+    }
+
+    // 活跃块覆盖的单元数（边缘块按整块计）
+    std::size_t activeCellCount() const { return activeTiles.size() * TILE_SIZE * TILE_SIZE; }
+
+    void simulate(int timeSteps, SinkFormat format = SinkFormat::CSV) {
+        SinkOptions options;
+        options.format = format;
+        TimeSeriesSink output(format == SinkFormat::CSV ? "simulation_data.csv" : "simulation_data.bin",
+                              {"Time", "Avg Population"}, options);
+        for (int t = 0; t < timeSteps; ++t) {
+            double avgPopulation = step();
+            output.append({static_cast<double>(t), avgPopulation});
+        }
+        output.close();
     }
 
 private:
-    std::vector<std::vector<Cell>> grid;
+    BacteriaGrid grid;
     int gridSize;
     int initialPopulation;
     double growthRate;
     double deathRate;
+    double effectiveGrowthRate;
     EnvironmentalFactors envFactors;
-    std::default_random_engine generator;
+    ThreadPool pool;
+    std::uint64_t seed;
+    EventMode eventMode;
+    std::uint64_t stepIndex;
+    std::uint64_t birthThreshold; // 32 位随机数小于该值即发生事件
+    std::uint64_t deathThreshold;
+    int tilesPerSide;
+    std::vector<long long> tilePopulation; // 每块在本步结束时的种群总数
+    bool sparse;                           // 是否允许跳过并移除空闲块
+    std::vector<std::uint32_t> activeTiles; // 活跃块编号，保持升序
+    std::vector<unsigned char> tileKeep;
+
+    void tileBounds(std::size_t tile, int& x0, int& y0, int& x1, int& y1) const {
+        x0 = static_cast<int>(tile / tilesPerSide) * TILE_SIZE;
+        y0 = static_cast<int>(tile % tilesPerSide) * TILE_SIZE;
+        x1 = std::min(x0 + TILE_SIZE, gridSize);
+        y1 = std::min(y0 + TILE_SIZE, gridSize);
+    }
 
-    void initializePopulation() {
-        for (int i = 0; i < initialPopulation; ++i) {
-            int x = rand() % gridSize;
-            int y = rand() % gridSize;
-            grid[x][y].population++;
+    bool tileIdle(std::size_t tile) const {
+        int x0, y0, x1, y1;
+        tileBounds(tile, x0, y0, x1, y1);
+        const float resourceLimit = static_cast<float>(DEFAULT_RESOURCE_LIMIT);
+        for (int x = x0; x < x1; ++x) {
+            for (int y = y0; y < y1; ++y) {
+                const std::size_t cell = grid.index(x, y);
+                if (grid.population[cell] > 0 || grid.resources[cell] < resourceLimit) return false;
+            }
         }
+        return true;
     }
 
-    void updatePopulation() {
-        for (int x = 0; x < gridSize; ++x) {
-            for (int y = 0; y < gridSize; ++y) {
-                double effectiveGrowthRate = adjustGrowthRate(envFactors.temperature, envFactors.pH, envFactors.nutrientConcentration);
-                if (grid[x][y].resources > 0) {
-                    if (std::bernoulli_distribution(effectiveGrowthRate)(generator)) {
-                        grid[x][y].population++;
-                    }
-                    if (std::bernoulli_distribution(deathRate)(generator) && grid[x][y].population > 0) {
-                        grid[x][y].population--;
+    static std::uint64_t probabilityThreshold(double p) {
+        return static_cast<std::uint64_t>(p * 4294967296.0);
+    }
+
+    // 在一块内一次完成原来的三遍扫描：出生 / 死亡与资源消耗、种群统计、资源补充。
+    // 每个单元的更新只依赖自身，因此融合后结果不变，而每个单元只读写一次。
+    // 随机数由 Philox(seed, 时间步, 单元编号) 给出：任意分块、任意线程数下每个单元取到的数都相同
+    // 返回该块在本步之后是否仍有活动（有个体或资源未满）
+    bool stepTile(std::size_t tile) {
+        int x0, y0, x1, y1;
+        tileBounds(tile, x0, y0, x1, y1);
+        const float resourceLimit = static_cast<float>(DEFAULT_RESOURCE_LIMIT);
+        const std::uint32_t stream[2] = {static_cast<std::uint32_t>(stepIndex), static_cast<std::uint32_t>(stepIndex >> 32)};
+
+        long long totalPopulation = 0;
+        bool active = false;
+        for (int x = x0; x < x1; ++x) {
+            int* population = &grid.population[grid.index(x, 0)];
+            float* resources = &grid.resources[grid.index(x, 0)];
+            for (int y = y0; y < y1; ++y) {
+                int cellPopulation = population[y];
+                float cellResources = resources[y];
+                if (cellResources > 0) {
+                    const std::uint32_t cell = static_cast<std::uint32_t>(grid.index(x, y));
+                    if (eventMode == EventMode::PerCell) {
+                        // 一次 Philox 调用同时给出出生与死亡两个伯努利试验，直接与整数阈值比较
+                        const std::uint32_t counter[4] = {0u, cell, stream[0], stream[1]};
+                        std::uint32_t bits[4];
+                        Philox4x32::generate(counter, seed, bits);
+                        if (bits[0] < birthThreshold) {
+                            cellPopulation++;
+                        }
+                        if (bits[1] < deathThreshold && cellPopulation > 0) {
+                            cellPopulation--;
+                        }
+                    } else if (cellPopulation > 0) {
+                        PhiloxRNG rng(seed, stepIndex, cell);
+                        const int births = static_cast<int>(std::min<std::uint32_t>(
+                            rng.binomial(cellPopulation, effectiveGrowthRate), static_cast<std::uint32_t>(cellResources)));
+                        cellPopulation += births;
+                        cellResources -= static_cast<float>(births);
+                        cellPopulation -= static_cast<int>(rng.binomial(cellPopulation, deathRate));
                     }
-                    if (grid[x][y].population > 0) {
-                        grid[x][y].resources -= 1;
+                    if (cellPopulation > 0 && cellResources > 0) {
+                        cellResources -= 1;
                     }
                 }
+                totalPopulation += cellPopulation;
+                if (cellResources < resourceLimit) {
+                    cellResources += 1;
+                }
+                population[y] = cellPopulation;
+                resources[y] = cellResources;
+                active = active || cellPopulation > 0 || cellResources < resourceLimit;
             }
         }
+        tilePopulation[tile] = totalPopulation;
+        return active;
+    }
+};
+
+// 事件计数：精确 SSA 执行的事件、tau-leaping 的跳跃次数与跳跃中批量发生的事件
+struct EngineStatistics {
+    unsigned long long ssaEvents = 0;
+    unsigned long long leaps = 0;
+    unsigned long long leapEvents = 0;
+
+    void add(const EngineStatistics& other) {
+        ssaEvents += other.ssaEvents;
+        leaps += other.leaps;
+        leapEvents += other.leapEvents;
     }
+};
 
-    double adjustGrowthRate(double temperature, double pH, double nutrient) {
-        // 这里可以添加基于实际生物学数据调整的逻辑
-        return growthRate * (1 + 0.1 * (temperature - 25)) * (1 - fabs(pH - 7) / 14) * (nutrient / 10);
+// 连续时间的随机引擎。每个单元有四个反应：
+//   出生  n -> n + 1, R -> R - 1，速率 growth * n（资源耗尽时为 0；与逐个体离散模型一样，每次出生消耗一份资源）
+//   死亡  n -> n - 1，速率 death * n
+//   消耗  R -> R - 1，速率 1（有个体且有资源时）
+//   补充  R -> R + 1，速率 1（资源低于上限时）
+// 时间单位与离散模型的一步相同。单元之间没有耦合，因此整体的 Gillespie 过程等价于每个单元各自独立演化。
+// 每个单元按 Cao、Gillespie 与 Petzold (2006) 的 tau 选择方法推进：
+// - 距离耗尽反应物不足 CRITICAL_FIRINGS 次的反应为临界反应，只能精确地发生一次；
+// - 非临界反应的跳跃长度使每个物种的期望变化与标准差都不超过 max(LEAP_EPSILON * x, 1)；
+// - 跳跃的期望事件数低于 SSA_EVENT_THRESHOLD 时改为连续执行 SSA_BURST 次精确 SSA；
+// - 跳跃后出现负数或资源超过上限时把跳跃长度减半重试。
+// 只有活跃单元（有个体或资源未满）参与计算，空闲单元永远不会再被激活，所以代价只与事件数和活跃单元数有关。
+class HybridGrowthEngine {
+public:
+    HybridGrowthEngine(int gridSize, int initialPopulation, double growthRate, double deathRate, const EnvironmentalFactors& envFactors,
+                       unsigned threads = std::thread::hardware_concurrency(), std::uint64_t seed = DEFAULT_SEED)
+        : gridSize(gridSize), growth(std::max(adjustGrowthRate(growthRate, envFactors), 0.0)), death(std::max(deathRate, 0.0)),
+          pool(threads), seed(seed), stepIndex(0) {
+        grid.reset(gridSize);
+        seedPopulation(grid, initialPopulation, seed);
+        for (std::size_t cell = 0; cell < grid.population.size(); ++cell) {
+            if (grid.population[cell] > 0) active.push_back(static_cast<std::uint32_t>(cell));
+        }
     }
 
-    double outputAveragePopulation() {
-        double totalPopulation = 0;
-        for (int x = 0; x < gridSize; ++x) {
-            for (int y = 0; y < gridSize; ++y) {
-                totalPopulation += grid[x][y].population;
+    // 推进一个时间单位，返回平均种群数
+    double advance() {
+        const std::size_t chunks = (active.size() + ACTIVE_CHUNK - 1) / ACTIVE_CHUNK;
+        chunkPopulation.assign(chunks, 0);
+        chunkStatistics.assign(chunks, EngineStatistics());
+        keep.resize(active.size());
+        overflowed = false;
+        pool.parallelFor(0, active.size(), ACTIVE_CHUNK, [this](std::size_t begin, std::size_t end) {
+            long long population = 0;
+            EngineStatistics statistics;
+            for (std::size_t a = begin; a < end; ++a) {
+                const std::uint32_t cell = active[a];
+                if (!advanceCell(cell, statistics)) overflowed = true;
+                population += grid.population[cell];
+                keep[a] = grid.population[cell] > 0 || grid.resources[cell] < static_cast<float>(DEFAULT_RESOURCE_LIMIT);
             }
+            chunkPopulation[begin / ACTIVE_CHUNK] = population;
+            chunkStatistics[begin / ACTIVE_CHUNK] = statistics;
+        });
+
+        if (overflowed) {
+            throw std::overflow_error("混合引擎: 单元种群数超出 int 范围");
+        }
+
+        // 按块的固定顺序归约，并去掉变为空闲的单元
+        long long totalPopulation = 0;
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            totalPopulation += chunkPopulation[chunk];
+            totals.add(chunkStatistics[chunk]);
+        }
+        std::size_t kept = 0;
+        for (std::size_t a = 0; a < active.size(); ++a) {
+            if (keep[a]) active[kept++] = active[a];
+        }
+        active.resize(kept);
+        ++stepIndex;
+        return static_cast<double>(totalPopulation) / (static_cast<double>(gridSize) * gridSize);
+    }
+
+    void simulate(int timeSteps, SinkFormat format = SinkFormat::CSV) {
+        SinkOptions options;
+        options.format = format;
+        TimeSeriesSink output(format == SinkFormat::CSV ? "hybrid_simulation_data.csv" : "hybrid_simulation_data.bin",
+                              {"Time", "Avg Population"}, options);
+        for (int t = 0; t < timeSteps; ++t) {
+            output.append({static_cast<double>(t), advance()});
         }
-        return totalPopulation / (gridSize * gridSize);
+        output.close();
     }
 
-    void distributeResources() {
-        for (int x = 0; x < gridSize; ++x) {
-            for (int y = 0; y < gridSize; ++y) {
-                if (grid[x][y].resources < DEFAULT_RESOURCE_LIMIT) {
-                    grid[x][y].resources += 1;
+    const EngineStatistics& statistics() const { return totals; }
+    std::size_t activeCells() const { return active.size(); }
+
+private:
+    static const std::size_t ACTIVE_CHUNK = 1024;
+    static const int REACTIONS = 4;                     // 出生、死亡、消耗、补充
+    static const long long CRITICAL_FIRINGS = 10;       // Cao 等人的 n_c
+    static const int SSA_BURST = 100;                   // 放弃跳跃时连续执行的精确 SSA 次数
+    static constexpr double LEAP_EPSILON = 0.03;        // 每次跳跃中各物种的相对变化上限
+    static constexpr double SSA_EVENT_THRESHOLD = 10.0; // 一次跳跃的期望事件数低于该值时改用精确 SSA
+    static constexpr double RESOURCE_RATE = 1.0;        // 资源消耗与补充的速率
+
+    BacteriaGrid grid;
+    int gridSize;
+    double growth;
+    double death;
+    ThreadPool pool;
+    std::uint64_t seed;
+    std::uint64_t stepIndex;
+    std::vector<std::uint32_t> active;          // 活跃单元编号，保持升序
+    std::vector<unsigned char> keep;
+    std::vector<long long> chunkPopulation;
+    std::vector<EngineStatistics> chunkStatistics;
+    EngineStatistics totals;
+    std::atomic<bool> overflowed{false};
+
+    // 各反应的速率、对 (n, R) 的改变量，以及距离耗尽反应物（补充反应为距离资源上限）还能发生的次数
+    static const int CHANGE_N[REACTIONS];
+    static const int CHANGE_R[REACTIONS];
+
+    void propensities(long long n, long long resources, long long resourceLimit, double rates[REACTIONS]) const {
+        rates[0] = resources > 0 ? growth * n : 0.0;
+        rates[1] = death * n;
+        rates[2] = n > 0 && resources > 0 ? RESOURCE_RATE : 0.0;
+        rates[3] = resources < resourceLimit ? RESOURCE_RATE : 0.0;
+    }
+
+    static void apply(int reaction, long long count, long long& n, long long& resources) {
+        n += CHANGE_N[reaction] * count;
+        resources += CHANGE_R[reaction] * count;
+    }
+
+    // Cao 等人对单个物种的跳跃长度上界：期望变化 |mu| 与方差 sigma2 都不超过 max(epsilon * x, 1)
+    static double speciesBound(long long x, double mu, double sigma2) {
+        const double allowed = std::max(LEAP_EPSILON * x, 1.0);
+        double tau = std::numeric_limits<double>::infinity();
+        if (mu != 0.0) tau = allowed / std::fabs(mu);
+        if (sigma2 > 0.0) tau = std::min(tau, allowed * allowed / sigma2);
+        return tau;
+    }
+
+    // 推进一个单元一个时间单位；种群数超出 int 范围时不写回并返回 false
+    bool advanceCell(std::uint32_t cell, EngineStatistics& statistics) {
+        PhiloxRNG rng(seed, stepIndex, cell);
+        const long long resourceLimit = static_cast<long long>(DEFAULT_RESOURCE_LIMIT);
+        long long n = grid.population[cell];
+        long long resources = static_cast<long long>(grid.resources[cell]);
+        double t = 0.0;
+        double rates[REACTIONS];
+        while (t < 1.0) {
+            propensities(n, resources, resourceLimit, rates);
+            const double totalRate = rates[0] + rates[1] + rates[2] + rates[3];
+            if (totalRate <= 0.0) break;
+
+            // 临界反应与非临界反应的漂移、方差
+            const long long remaining[REACTIONS] = {resources, n, resources, resourceLimit - resources};
+            bool critical[REACTIONS];
+            double criticalRate = 0.0, muN = 0.0, sigmaN = 0.0, muR = 0.0, sigmaR = 0.0;
+            for (int r = 0; r < REACTIONS; ++r) {
+                critical[r] = rates[r] > 0.0 && remaining[r] < CRITICAL_FIRINGS;
+                if (critical[r]) {
+                    criticalRate += rates[r];
+                } else {
+                    muN += CHANGE_N[r] * rates[r];
+                    sigmaN += CHANGE_N[r] * CHANGE_N[r] * rates[r];
+                    muR += CHANGE_R[r] * rates[r];
+                    sigmaR += CHANGE_R[r] * CHANGE_R[r] * rates[r];
                 }
             }
+            double leapTau = std::min(speciesBound(n, muN, sigmaN), speciesBound(resources, muR, sigmaR));
+
+            if (leapTau * totalRate < SSA_EVENT_THRESHOLD) {
+                // 精确 SSA：指数分布的等待时间，按速率比例选择反应
+                for (int burst = 0; burst < SSA_BURST && t < 1.0; ++burst) {
+                    propensities(n, resources, resourceLimit, rates);
+                    const double rate = rates[0] + rates[1] + rates[2] + rates[3];
+                    if (rate <= 0.0) {
+                        t = 1.0;
+                        break;
+                    }
+                    t += -std::log(rng.uniformDouble()) / rate;
+                    if (t >= 1.0) break;
+                    double pick = rng.uniformDouble() * rate;
+                    int reaction = 0;
+                    while (reaction < REACTIONS - 1 && pick >= rates[reaction]) pick -= rates[reaction++];
+                    apply(reaction, 1, n, resources);
+                    ++statistics.ssaEvents;
+                }
+                continue;
+            }
+
+            // tau-leaping：非临界反应各做一次泊松抽样；若临界反应的等待时间更短，则恰好发生一次临界反应
+            const double criticalTau = criticalRate > 0.0 ? -std::log(rng.uniformDouble()) / criticalRate
+                                                          : std::numeric_limits<double>::infinity();
+            for (;;) {
+                const double tau = std::min(std::min(leapTau, criticalTau), 1.0 - t);
+                long long nextN = n, nextResources = resources, events = 0;
+                for (int r = 0; r < REACTIONS; ++r) {
+                    if (critical[r] || rates[r] <= 0.0) continue;
+                    const long long count = static_cast<long long>(rng.poisson(rates[r] * tau));
+                    apply(r, count, nextN, nextResources);
+                    events += count;
+                }
+                if (criticalTau <= leapTau && criticalTau < 1.0 - t) {
+                    double pick = rng.uniformDouble() * criticalRate;
+                    int reaction = 0;
+                    while (reaction < REACTIONS - 1 && (!critical[reaction] || pick >= rates[reaction])) {
+                        if (critical[reaction]) pick -= rates[reaction];
+                        ++reaction;
+                    }
+                    apply(reaction, 1, nextN, nextResources);
+                    ++events;
+                }
+                if (nextN >= 0 && nextResources >= 0 && nextResources <= resourceLimit) {
+                    n = nextN;
+                    resources = nextResources;
+                    t += tau;
+                    ++statistics.leaps;
+                    statistics.leapEvents += events;
+                    break;
+                }
+                leapTau *= 0.5; // 跳跃越界：减半重试
+            }
         }
+        if (n > std::numeric_limits<int>::max()) return false;
+        grid.population[cell] = static_cast<int>(n);
+        grid.resources[cell] = static_cast<float>(resources);
+        return true;
     }
 };
 
-void loadConfig(const std::string& configFile, int& gridSize, int& initialPopulation, double& growthRate, double& deathRate, EnvironmentalFactors& envFactors) {
+const int HybridGrowthEngine::CHANGE_N[HybridGrowthEngine::REACTIONS] = {1, -1, 0, 0};
+const int HybridGrowthEngine::CHANGE_R[HybridGrowthEngine::REACTIONS] = {-1, 0, -1, 1};
+
+// 以相同的参数与种子比较离散模型 simulate() 的逐步推进与混合引擎，报告耗时与事件数
+int runEngineBenchmark(int gridSize, int initialPopulation, double growthRate, double deathRate, const EnvironmentalFactors& envFactors,
+                       int timeSteps, unsigned threads, std::uint64_t seed) {
+    std::cout << "engine,seconds,steps_per_s,final_avg_population,events,leaps,active_cells" << std::endl;
+
+    const EventMode modes[2] = {EventMode::PerCell, EventMode::PerOrganism};
+    for (EventMode mode : modes) {
+        BacterialGrowthModel model(gridSize, initialPopulation, growthRate, deathRate, envFactors, threads, seed, mode);
+        double average = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < timeSteps; ++t) average = model.step();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (mode == EventMode::PerCell ? "discrete_cell" : "discrete_organism") << "," << seconds << ","
+                  << timeSteps / seconds << "," << average << ",,," << model.activeCellCount() << std::endl;
+    }
+
+    HybridGrowthEngine engine(gridSize, initialPopulation, growthRate, deathRate, envFactors, threads, seed);
+    double average = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < timeSteps; ++t) average = engine.advance();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const EngineStatistics& statistics = engine.statistics();
+    std::cout << "hybrid," << seconds << "," << timeSteps / seconds << "," << average << ","
+              << statistics.ssaEvents + statistics.leapEvents << "," << statistics.leaps << ","
+              << engine.activeCells() << std::endl;
+    std::cerr << "hybrid: " << statistics.ssaEvents << " SSA events, " << statistics.leaps << " leaps covering "
+              << statistics.leapEvents << " events" << std::endl;
+    return 0;
+}
+
+// 回归检查：以高生长率的稠密配置（生长概率截断为 1，原先逐个体模式在第 32 步溢出为负数）运行两种事件模式，
+// 确认平均种群数始终有限、非负，且不超过每步每单元至多增加 DEFAULT_RESOURCE_LIMIT 的上界。失败时返回 1
+int runSelfCheck(unsigned threads) {
+    const int gridSize = 200;
+    const int initialPopulation = 20000;
+    const int timeSteps = 200;
+    const EnvironmentalFactors envFactors(37.0, 7.0, 5.0);
+    const double initialAverage = static_cast<double>(initialPopulation) / (gridSize * gridSize);
+
+    bool passed = true;
+    const EventMode modes[2] = {EventMode::PerCell, EventMode::PerOrganism};
+    for (EventMode mode : modes) {
+        BacterialGrowthModel model(gridSize, initialPopulation, 3.0, 0.02, envFactors, threads, DEFAULT_SEED, mode);
+        const char* name = mode == EventMode::PerCell ? "discrete_cell" : "discrete_organism";
+        for (int t = 0; t < timeSteps; ++t) {
+            const double average = model.step();
+            const double bound = initialAverage + DEFAULT_RESOURCE_LIMIT * (t + 1);
+            if (!(average >= 0.0 && average <= bound)) {
+                std::cerr << name << ": 第 " << t << " 步平均种群数 " << average << " 超出 [0, " << bound << "]" << std::endl;
+                passed = false;
+                break;
+            }
+        }
+    }
+    HybridGrowthEngine engine(gridSize, initialPopulation, 3.0, 0.02, envFactors, threads, DEFAULT_SEED);
+    for (int t = 0; t < timeSteps; ++t) {
+        const double average = engine.advance();
+        const double bound = initialAverage + DEFAULT_RESOURCE_LIMIT * (t + 1);
+        if (!(average >= 0.0 && average <= bound)) {
+            std::cerr << "hybrid: 第 " << t << " 步平均种群数 " << average << " 超出 [0, " << bound << "]" << std::endl;
+            passed = false;
+            break;
+        }
+    }
+    std::cout << (passed ? "self-check passed" : "self-check FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
+
+// 读取可选的 "event_mode"："cell" 或 "organism"
+void readEventMode(const json& j, EventMode& eventMode) {
+    if (!j.contains("event_mode")) return;
+    const std::string mode = j["event_mode"].get<std::string>();
+    if (mode == "cell") {
+        eventMode = EventMode::PerCell;
+    } else if (mode == "organism") {
+        eventMode = EventMode::PerOrganism;
+    } else {
+        throw std::runtime_error("未知的 event_mode: " + mode);
+    }
+}
+
+void loadConfig(const std::string& configFile, int& gridSize, int& initialPopulation, double& growthRate, double& deathRate, EnvironmentalFactors& envFactors,
+                std::uint64_t& seed, EventMode& eventMode) {
     std::ifstream file(configFile);
     if (!file.is_open()) {
         throw std::runtime_error("无法打开配置文件");
@@ -137,6 +585,196 @@ void loadConfig(const std::string& configFile, int& gridSize, int& initialPopula
     envFactors.temperature = j.contains("temperature") ? j["temperature"].get<double>() : 25.0;
     envFactors.pH = j.contains("pH") ? j["pH"].get<double>() : 7.0;
     envFactors.nutrientConcentration = j.contains("nutrient_concentration") ? j["nutrient_concentration"].get<double>() : 1.0;
+    seed = j.contains("seed") ? j["seed"].get<std::uint64_t>() : DEFAULT_SEED;
+    readEventMode(j, eventMode);
+}
+
+// 参数扫描中一个参数的取值：先查 "sweep" 对象，再查顶层。取值可以是数组、单个数值，
+// 或 {"start", "stop", "count"} 表示的等距序列；都没有给出时使用默认值
+std::vector<double> sweepValues(const json& spec, const std::string& name, double fallback) {
+    const json* entry = nullptr;
+    if (spec.contains("sweep") && spec["sweep"].contains(name)) {
+        entry = &spec["sweep"][name];
+    } else if (spec.contains(name)) {
+        entry = &spec[name];
+    }
+    if (!entry) return std::vector<double>(1, fallback);
+
+    std::vector<double> values;
+    if (entry->is_array()) {
+        for (const auto& value : *entry) values.push_back(value.get<double>());
+    } else if (entry->is_object()) {
+        const double start = (*entry)["start"].get<double>();
+        const double stop = (*entry)["stop"].get<double>();
+        const int count = (*entry)["count"].get<int>();
+        for (int k = 0; k < count; ++k) {
+            values.push_back(count == 1 ? start : start + (stop - start) * k / (count - 1));
+        }
+    } else {
+        values.push_back(entry->get<double>());
+    }
+    if (values.empty()) {
+        throw std::runtime_error("参数 " + name + " 没有取值");
+    }
+    return values;
+}
+
+// 集合模拟中的一组参数
+struct EnsembleCase {
+    double growthRate;
+    double deathRate;
+    EnvironmentalFactors envFactors;
+};
+
+// 每个工作线程的工作区：模型（网格只在第一次使用时分配）与逐步统计量
+struct EnsembleWorkspace {
+    std::unique_ptr<BacterialGrowthModel> model;
+    std::vector<double> mean;
+    std::vector<double> m2;
+};
+
+// 参数扫描 / 集合模拟：对 growth_rate、death_rate、temperature、pH、nutrient_concentration
+// 各取值的笛卡尔积，每组参数重复 replicates 次，在工作窃取线程池上并行运行。
+// 每组参数由一个任务按顺序跑完所有重复并用 Welford 算法累积每步平均种群数的均值与方差，
+// 不产生逐次运行的输出文件；结果按参数组编号的顺序流式写入一个汇总文件，与线程数无关。
+// 同时在运行或等待写出的参数组最多为线程数的两倍，暂存的结果行不随参数组总数增长。
+// 第 r 次重复在所有参数组中使用同一个种子（公共随机数），参数组之间的差异不受抽样噪声放大。
+int runEnsemble(const std::string& specFile, int timeSteps, unsigned threads, SinkFormat format) {
+    std::ifstream file(specFile);
+    if (!file.is_open()) {
+        throw std::runtime_error("无法打开参数扫描文件: " + specFile);
+    }
+    json spec;
+    file >> spec;
+
+    const int gridSize = spec.contains("grid_size") ? spec["grid_size"].get<int>() : DEFAULT_GRID_SIZE;
+    const int initialPopulation =
+        spec.contains("initial_population") ? spec["initial_population"].get<int>() : DEFAULT_INITIAL_POPULATION;
+    const int replicates = spec.contains("replicates") ? spec["replicates"].get<int>() : 1;
+    const std::uint64_t baseSeed = spec.contains("seed") ? spec["seed"].get<std::uint64_t>() : DEFAULT_SEED;
+    if (spec.contains("time_steps")) timeSteps = spec["time_steps"].get<int>();
+    EventMode eventMode = EventMode::PerCell;
+    readEventMode(spec, eventMode);
+    if (gridSize <= 0 || replicates <= 0 || timeSteps <= 0) {
+        throw std::runtime_error("grid_size、replicates 与 time_steps 必须为正数");
+    }
+
+    const std::vector<double> growthRates = sweepValues(spec, "growth_rate", DEFAULT_GROWTH_RATE);
+    const std::vector<double> deathRates = sweepValues(spec, "death_rate", DEFAULT_DEATH_RATE);
+    const std::vector<double> temperatures = sweepValues(spec, "temperature", 25.0);
+    const std::vector<double> pHs = sweepValues(spec, "pH", 7.0);
+    const std::vector<double> nutrients = sweepValues(spec, "nutrient_concentration", 1.0);
+    std::vector<EnsembleCase> cases;
+    for (double growthRate : growthRates) {
+        for (double deathRate : deathRates) {
+            for (double temperature : temperatures) {
+                for (double pH : pHs) {
+                    for (double nutrient : nutrients) {
+                        cases.push_back(EnsembleCase{growthRate, deathRate, EnvironmentalFactors(temperature, pH, nutrient)});
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::uint64_t> seeds(replicates);
+    for (int r = 0; r < replicates; ++r) {
+        PhiloxRNG rng(baseSeed, static_cast<std::uint64_t>(r));
+        const std::uint64_t high = rng.nextUInt();
+        seeds[r] = (high << 32) | rng.nextUInt();
+    }
+
+    std::string outputPath = spec.contains("output") ? spec["output"].get<std::string>() : "ensemble_statistics";
+    outputPath += format == SinkFormat::CSV ? ".csv" : ".bin";
+    SinkOptions options;
+    options.format = format;
+    TimeSeriesSink output(outputPath,
+                          {"Case", "Growth Rate", "Death Rate", "Temperature", "pH", "Nutrient", "Time",
+                           "Mean Avg Population", "Variance Avg Population"},
+                          options);
+
+    WorkStealingPool pool(threads);
+    std::vector<EnsembleWorkspace> workspaces(pool.size());
+
+    // 先完成的参数组暂存在 finished 中，直到编号连续后再按顺序写出
+    std::mutex outputMutex;
+    std::condition_variable written;
+    std::map<std::size_t, std::vector<double>> finished;
+    std::size_t nextCase = 0;
+    bool aborted = false; // 有参数组失败时停止提交，异常由 pool.wait() 重新抛出
+    const std::size_t maxInFlight = 2 * static_cast<std::size_t>(pool.size());
+
+    auto runCase = [&](std::size_t c, unsigned worker) {
+        const EnsembleCase& ensembleCase = cases[c];
+        EnsembleWorkspace& workspace = workspaces[worker];
+        workspace.mean.assign(timeSteps, 0.0);
+        workspace.m2.assign(timeSteps, 0.0);
+        for (int r = 0; r < replicates; ++r) {
+            if (!workspace.model) {
+                workspace.model.reset(new BacterialGrowthModel(gridSize, initialPopulation, ensembleCase.growthRate,
+                                                               ensembleCase.deathRate, ensembleCase.envFactors, 1,
+                                                               seeds[r], eventMode));
+            } else {
+                workspace.model->reset(initialPopulation, ensembleCase.growthRate, ensembleCase.deathRate,
+                                       ensembleCase.envFactors, seeds[r], eventMode);
+            }
+            for (int t = 0; t < timeSteps; ++t) {
+                const double value = workspace.model->step();
+                const double delta = value - workspace.mean[t];
+                workspace.mean[t] += delta / (r + 1);
+                workspace.m2[t] += delta * (value - workspace.mean[t]);
+            }
+        }
+
+        std::vector<double> rows(static_cast<std::size_t>(timeSteps) * 9);
+        for (int t = 0; t < timeSteps; ++t) {
+            double* row = &rows[static_cast<std::size_t>(t) * 9];
+            row[0] = static_cast<double>(c);
+            row[1] = ensembleCase.growthRate;
+            row[2] = ensembleCase.deathRate;
+            row[3] = ensembleCase.envFactors.temperature;
+            row[4] = ensembleCase.envFactors.pH;
+            row[5] = ensembleCase.envFactors.nutrientConcentration;
+            row[6] = t;
+            row[7] = workspace.mean[t];
+            row[8] = replicates > 1 ? workspace.m2[t] / (replicates - 1) : 0.0;
+        }
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        finished[c].swap(rows);
+        for (auto it = finished.begin(); it != finished.end() && it->first == nextCase; it = finished.erase(it)) {
+            for (std::size_t k = 0; k < it->second.size(); k += 9) output.append(&it->second[k]);
+            ++nextCase;
+        }
+        written.notify_all();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t c = 0; c < cases.size(); ++c) {
+        {
+            std::unique_lock<std::mutex> lock(outputMutex);
+            written.wait(lock, [&] { return aborted || c < nextCase + maxInFlight; });
+            if (aborted) break;
+        }
+        pool.submit([&, c](unsigned worker) {
+            try {
+                runCase(c, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                aborted = true;
+                written.notify_all();
+                throw;
+            }
+        });
+    }
+    pool.wait();
+    output.close();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double runs = static_cast<double>(cases.size()) * replicates;
+    std::cout << "ensemble: " << cases.size() << " cases x " << replicates << " replicates on " << pool.size()
+              << " threads in " << seconds << " s (" << runs / seconds << " runs/s) -> " << outputPath << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -146,14 +784,67 @@ int main(int argc, char* argv[]) {
     double deathRate = DEFAULT_DEATH_RATE;
     EnvironmentalFactors envFactors;
     int timeSteps = 50;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::uint64_t seed = DEFAULT_SEED;
+    EventMode eventMode = EventMode::PerCell;
+    bool seedOverride = false;
+    bool hybrid = false;
+    bool benchmark = false;
+    bool selfCheck = false;
+    SinkFormat format = SinkFormat::CSV;
+    std::string configFile;
+    std::string ensembleFile;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--threads" && a + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++a]));
+        } else if (arg == "--steps" && a + 1 < argc) {
+            timeSteps = std::atoi(argv[++a]);
+        } else if (arg == "--seed" && a + 1 < argc) {
+            seed = std::strtoull(argv[++a], nullptr, 10);
+            seedOverride = true;
+        } else if (arg == "--per-organism") {
+            eventMode = EventMode::PerOrganism;
+        } else if (arg == "--hybrid") {
+            hybrid = true;
+        } else if (arg == "--bench-engines") {
+            benchmark = true;
+        } else if (arg == "--self-check") {
+            selfCheck = true;
+        } else if (arg == "--ensemble" && a + 1 < argc) {
+            ensembleFile = argv[++a];
+        } else if (arg == "--binary") {
+            format = SinkFormat::Binary;
+        } else {
+            configFile = arg;
+        }
+    }
 
     try {
-        if (argc > 1) {
-            loadConfig(argv[1], gridSize, initialPopulation, growthRate, deathRate, envFactors);
+        if (selfCheck) {
+            return runSelfCheck(threads);
+        }
+        if (!ensembleFile.empty()) {
+            return runEnsemble(ensembleFile, timeSteps, threads, format);
+        }
+        if (!configFile.empty()) {
+            const std::uint64_t commandLineSeed = seed;
+            loadConfig(configFile, gridSize, initialPopulation, growthRate, deathRate, envFactors, seed, eventMode);
+            if (seedOverride) seed = commandLineSeed;
+        }
+
+        if (benchmark) {
+            return runEngineBenchmark(gridSize, initialPopulation, growthRate, deathRate, envFactors, timeSteps, threads, seed);
+        }
+        if (hybrid) {
+            HybridGrowthEngine engine(gridSize, initialPopulation, growthRate, deathRate, envFactors, threads, seed);
+            engine.simulate(timeSteps, format);
+            return 0;
         }
 
-        BacterialGrowthModel model(gridSize, initialPopulation, growthRate, deathRate, envFactors);
-        model.simulate(timeSteps);
+        BacterialGrowthModel model(gridSize, initialPopulation, growthRate, deathRate, envFactors, threads, seed, eventMode);
+        model.simulate(timeSteps, format);
     } catch (const std::exception& e) {
         std::cerr << "发生错误: " << e.what() << std::endl;
         return 1;
@@ -4,9 +4,12 @@
 #include <bitset>
 #include <fstream>
 #include <stdexcept>
+#include "TimeSeriesSink.h"
 
 class BaseConverter {
 public:
+    BaseConverter() : logFile("conversion_log.txt", {}, appendOptions()) {}
+
     // 从十进制转换
     void convertFromDecimal(int decimal, int base) {
         switch (base) {
@@ -50,17 +53,21 @@ public:
         return decimal;
     }
 
-    // 保存日志
+    // 保存日志：日志文件只打开一次，消息由后台线程写出
     void log(const std::string& message) {
-        std::ofstream logFile("conversion_log.txt", std::ios::app);
-        if (!logFile.is_open()) {
-            throw std::runtime_error("Could not open log file.");
-        }
-        logFile << message << std::endl;
-        logFile.close();
+        logFile.appendLine(message);
     }
 
 private:
+    TimeSeriesSink logFile;
+
+    static SinkOptions appendOptions() {
+        SinkOptions options;
+        options.append = true;
+        options.threaded = false; // 只有几行日志，不值得开写线程
+        return options;
+    }
+
     int decimalToOctal(int decimal) {
         int octal = 0, place = 1;
         while (decimal != 0) {
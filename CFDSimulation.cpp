@@ -1,120 +1,1936 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
-#include <sstream>
+#include <string>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include "ThreadPool.h"
+#include "FrameStats.h"
+#include "OffscreenExport.h"
+#ifdef CFD_WITH_ZLIB
+#include <zlib.h>
+#endif
+#include <cstdint>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+// 定义 CFD_HEADLESS 编译时将不依赖 OpenGL/GLFW，用于无显示的批处理节点
+#ifndef CFD_HEADLESS
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <cmath>
+#endif
 
-const int GRID_SIZE = 20;           // 网格大小
+const int GRID_SIZE = 20;           // 默认网格大小（可通过命令行 --size 指定）
 const float TIME_STEP = 0.01;       // 时间步长
 const int TIME_STEPS = 100;          // 模拟时间步骤
+const int BENCH_GRID_SIZE = 2048;   // 扩展性基准的默认网格大小
+const int ROW_BLOCK = 8;            // 每个并行任务处理的行数
+const std::size_t FIELD_ALIGNMENT = 64; // 场数组对齐字节数（缓存行 / AVX-512 宽度）
+
+inline float* alignedAllocFloats(std::size_t count) {
+    void* memory = nullptr;
+    std::size_t bytes = std::max<std::size_t>(count, 1) * sizeof(float);
+#ifdef _WIN32
+    memory = _aligned_malloc(bytes, FIELD_ALIGNMENT);
+#else
+    if (posix_memalign(&memory, FIELD_ALIGNMENT, bytes) != 0) memory = nullptr;
+#endif
+    if (!memory) throw std::bad_alloc();
+    return static_cast<float*>(memory);
+}
 
-class FluidCell {
+inline void alignedFreeFloats(float* memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+// 按 FIELD_ALIGNMENT 对齐的连续 float 数组，只可移动不可复制
+class FieldArray {
 public:
-    float temperature;
-    float density;
-    float velocityX;
-    float velocityY;
+    FieldArray() : size(0) {}
+
+    explicit FieldArray(std::size_t count, float value = 0.0f)
+        : storage(alignedAllocFloats(count), alignedFreeFloats), size(count) {
+        std::fill(storage.get(), storage.get() + size, value);
+    }
 
-    FluidCell(float temp = 0.0f, float dens = 0.0f) 
-        : temperature(temp), density(dens), velocityX(0.0f), velocityY(0.0f) {}
+    // 引用外部内存（如映射文件），owner 保证数据在数组存活期间有效
+    template <typename Owner>
+    FieldArray(const std::shared_ptr<Owner>& owner, float* external, std::size_t count)
+        : storage(owner, external), size(count) {}
+
+    FieldArray(FieldArray&& other) : storage(std::move(other.storage)), size(other.size) { other.size = 0; }
+    FieldArray& operator=(FieldArray&& other) {
+        storage = std::move(other.storage);
+        size = other.size;
+        other.size = 0;
+        return *this;
+    }
+    FieldArray(const FieldArray&) = delete;
+    FieldArray& operator=(const FieldArray&) = delete;
+
+    float* data() { return storage.get(); }
+    const float* data() const { return storage.get(); }
+    std::size_t count() const { return size; }
+    float& operator[](std::size_t i) { return storage.get()[i]; }
+    float operator[](std::size_t i) const { return storage.get()[i]; }
+
+private:
+    std::shared_ptr<float> storage;
+    std::size_t size;
 };
 
-class CFDSimulation {
+// 结构数组（SoA）形式的流体场：每个物理量一段连续内存，按行主序存放
+// 下标 (i, j) 对应第 i 行、第 j 列，i ∈ [0, ny)，j ∈ [0, nx)
+struct FluidFields {
+    int nx;
+    int ny;
+    FieldArray temperature;
+    FieldArray density;
+    FieldArray velocityX;
+    FieldArray velocityY;
+
+    FluidFields(int nx, int ny)
+        : nx(nx), ny(ny),
+          temperature(cellCount(nx, ny)), density(cellCount(nx, ny)),
+          velocityX(cellCount(nx, ny)), velocityY(cellCount(nx, ny)) {}
+
+    std::size_t index(int i, int j) const { return static_cast<std::size_t>(i) * nx + j; }
+    std::size_t cells() const { return static_cast<std::size_t>(nx) * ny; }
+
+    static std::size_t cellCount(int nx, int ny) {
+        if (nx < 3 || ny < 3) {
+            throw std::invalid_argument("Grid must be at least 3x3");
+        }
+        return static_cast<std::size_t>(nx) * ny;
+    }
+};
+
+// CFD 行内核。每个函数处理一行中连续的 count 个内部单元，指针指向第一个单元。
+// scalar 版本是参考实现。SIMD 版本按同样的顺序做同样的 IEEE 运算（不化简公式、不使用 FMA），
+// 每个单元的结果与参考实现逐位相同，包括密度为 0 时的 NaN，因此结果不随 CPU 的指令集变化（见 --selfcheck）。
+// 编译器可能把 a * b + c 收缩成 FMA（GCC 对 AVX-512 内建函数在 ISO 模式下也会这样做），所以内核所在的区段关闭了浮点收缩。
+struct CFDKernels {
+    const char* name;
+    void (*reactionRow)(const float* temperature, const float* density, const float* velocityX, const float* velocityY,
+                        float* nextTemperature, float* nextDensity, float* nextVelocityX, float* nextVelocityY, int count);
+    // f = -scale * (∂u/∂x + ∂v/∂y)，中心差分，stride 为行长
+    void (*divergenceRow)(const float* velocityX, const float* velocityY, int stride, float* f, int count, float scale);
+    // u -= scale * ∂p/∂x，v -= scale * ∂p/∂y
+    void (*subtractGradientRow)(const float* p, int stride, float* velocityX, float* velocityY, int count, float scale);
+};
+
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+void reactionRowScalar(const float* __restrict temperature, const float* __restrict density,
+                       const float* __restrict velocityX, const float* __restrict velocityY,
+                       float* __restrict nextTemperature, float* __restrict nextDensity,
+                       float* __restrict nextVelocityX, float* __restrict nextVelocityY, int count) {
+    for (int j = 0; j < count; ++j) {
+        // 简化的流体动力学计算
+        float pressure = (density[j] * temperature[j]) / 1000.0f;
+
+        // 更新速度（动量守恒）
+        float acceleration = (pressure / density[j]) * TIME_STEP;
+        float vx = velocityX[j] - acceleration;
+        float vy = velocityY[j] - acceleration;
+        nextVelocityX[j] = vx;
+        nextVelocityY[j] = vy;
+
+        // 更新温度
+        nextTemperature[j] = temperature[j] + (0.1f * vx + 0.1f * vy); // 热源
+
+        // 更新密度
+        nextDensity[j] = density[j] * 1.001f;  // 简化反应过程
+    }
+}
+
+void divergenceRowScalar(const float* velocityX, const float* velocityY, int stride, float* f, int count, float scale) {
+    for (int j = 0; j < count; ++j) {
+        f[j] = -scale * (velocityX[j + 1] - velocityX[j - 1] + velocityY[j + stride] - velocityY[j - stride]);
+    }
+}
+
+void subtractGradientRowScalar(const float* p, int stride, float* velocityX, float* velocityY, int count, float scale) {
+    for (int j = 0; j < count; ++j) {
+        velocityX[j] -= scale * (p[j + 1] - p[j - 1]);
+        velocityY[j] -= scale * (p[j + stride] - p[j - stride]);
+    }
+}
+
+const CFDKernels SCALAR_KERNELS = {"scalar", reactionRowScalar, divergenceRowScalar, subtractGradientRowScalar};
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CFD_X86_KERNELS 1
+#include <immintrin.h>
+
+__attribute__((target("sse4.2")))
+void reactionRowSSE42(const float* temperature, const float* density, const float* velocityX, const float* velocityY,
+                      float* nextTemperature, float* nextDensity, float* nextVelocityX, float* nextVelocityY, int count) {
+    const __m128 thousand = _mm_set1_ps(1000.0f);
+    const __m128 dt = _mm_set1_ps(TIME_STEP);
+    const __m128 heat = _mm_set1_ps(0.1f);
+    const __m128 growth = _mm_set1_ps(1.001f);
+    int j = 0;
+    for (; j + 4 <= count; j += 4) {
+        __m128 t = _mm_loadu_ps(temperature + j);
+        __m128 rho = _mm_loadu_ps(density + j);
+        __m128 pressure = _mm_div_ps(_mm_mul_ps(rho, t), thousand);
+        __m128 a = _mm_mul_ps(_mm_div_ps(pressure, rho), dt);
+        __m128 vx = _mm_sub_ps(_mm_loadu_ps(velocityX + j), a);
+        __m128 vy = _mm_sub_ps(_mm_loadu_ps(velocityY + j), a);
+        _mm_storeu_ps(nextVelocityX + j, vx);
+        _mm_storeu_ps(nextVelocityY + j, vy);
+        _mm_storeu_ps(nextTemperature + j, _mm_add_ps(t, _mm_add_ps(_mm_mul_ps(heat, vx), _mm_mul_ps(heat, vy))));
+        _mm_storeu_ps(nextDensity + j, _mm_mul_ps(rho, growth));
+    }
+    reactionRowScalar(temperature + j, density + j, velocityX + j, velocityY + j,
+                      nextTemperature + j, nextDensity + j, nextVelocityX + j, nextVelocityY + j, count - j);
+}
+
+__attribute__((target("sse4.2")))
+void divergenceRowSSE42(const float* velocityX, const float* velocityY, int stride, float* f, int count, float scale) {
+    const __m128 s = _mm_set1_ps(-scale);
+    int j = 0;
+    for (; j + 4 <= count; j += 4) {
+        // 与参考实现相同的求值顺序：((u[j+1] - u[j-1]) + v[j+stride]) - v[j-stride]
+        __m128 sum = _mm_sub_ps(_mm_loadu_ps(velocityX + j + 1), _mm_loadu_ps(velocityX + j - 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(velocityY + j + stride));
+        sum = _mm_sub_ps(sum, _mm_loadu_ps(velocityY + j - stride));
+        _mm_storeu_ps(f + j, _mm_mul_ps(s, sum));
+    }
+    divergenceRowScalar(velocityX + j, velocityY + j, stride, f + j, count - j, scale);
+}
+
+__attribute__((target("sse4.2")))
+void subtractGradientRowSSE42(const float* p, int stride, float* velocityX, float* velocityY, int count, float scale) {
+    const __m128 s = _mm_set1_ps(scale);
+    int j = 0;
+    for (; j + 4 <= count; j += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(p + j + 1), _mm_loadu_ps(p + j - 1));
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(p + j + stride), _mm_loadu_ps(p + j - stride));
+        _mm_storeu_ps(velocityX + j, _mm_sub_ps(_mm_loadu_ps(velocityX + j), _mm_mul_ps(s, dx)));
+        _mm_storeu_ps(velocityY + j, _mm_sub_ps(_mm_loadu_ps(velocityY + j), _mm_mul_ps(s, dy)));
+    }
+    subtractGradientRowScalar(p + j, stride, velocityX + j, velocityY + j, count - j, scale);
+}
+
+__attribute__((target("avx2")))
+void reactionRowAVX2(const float* temperature, const float* density, const float* velocityX, const float* velocityY,
+                     float* nextTemperature, float* nextDensity, float* nextVelocityX, float* nextVelocityY, int count) {
+    const __m256 thousand = _mm256_set1_ps(1000.0f);
+    const __m256 dt = _mm256_set1_ps(TIME_STEP);
+    const __m256 heat = _mm256_set1_ps(0.1f);
+    const __m256 growth = _mm256_set1_ps(1.001f);
+    int j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m256 t = _mm256_loadu_ps(temperature + j);
+        __m256 rho = _mm256_loadu_ps(density + j);
+        __m256 pressure = _mm256_div_ps(_mm256_mul_ps(rho, t), thousand);
+        __m256 a = _mm256_mul_ps(_mm256_div_ps(pressure, rho), dt);
+        __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(velocityX + j), a);
+        __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(velocityY + j), a);
+        _mm256_storeu_ps(nextVelocityX + j, vx);
+        _mm256_storeu_ps(nextVelocityY + j, vy);
+        _mm256_storeu_ps(nextTemperature + j, _mm256_add_ps(t, _mm256_add_ps(_mm256_mul_ps(heat, vx), _mm256_mul_ps(heat, vy))));
+        _mm256_storeu_ps(nextDensity + j, _mm256_mul_ps(rho, growth));
+    }
+    reactionRowScalar(temperature + j, density + j, velocityX + j, velocityY + j,
+                      nextTemperature + j, nextDensity + j, nextVelocityX + j, nextVelocityY + j, count - j);
+}
+
+__attribute__((target("avx2")))
+void divergenceRowAVX2(const float* velocityX, const float* velocityY, int stride, float* f, int count, float scale) {
+    const __m256 s = _mm256_set1_ps(-scale);
+    int j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m256 sum = _mm256_sub_ps(_mm256_loadu_ps(velocityX + j + 1), _mm256_loadu_ps(velocityX + j - 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(velocityY + j + stride));
+        sum = _mm256_sub_ps(sum, _mm256_loadu_ps(velocityY + j - stride));
+        _mm256_storeu_ps(f + j, _mm256_mul_ps(s, sum));
+    }
+    divergenceRowScalar(velocityX + j, velocityY + j, stride, f + j, count - j, scale);
+}
+
+__attribute__((target("avx2")))
+void subtractGradientRowAVX2(const float* p, int stride, float* velocityX, float* velocityY, int count, float scale) {
+    const __m256 s = _mm256_set1_ps(scale);
+    int j = 0;
+    for (; j + 8 <= count; j += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(p + j + 1), _mm256_loadu_ps(p + j - 1));
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(p + j + stride), _mm256_loadu_ps(p + j - stride));
+        _mm256_storeu_ps(velocityX + j, _mm256_sub_ps(_mm256_loadu_ps(velocityX + j), _mm256_mul_ps(s, dx)));
+        _mm256_storeu_ps(velocityY + j, _mm256_sub_ps(_mm256_loadu_ps(velocityY + j), _mm256_mul_ps(s, dy)));
+    }
+    subtractGradientRowScalar(p + j, stride, velocityX + j, velocityY + j, count - j, scale);
+}
+
+// AVX-512 版本用掩码处理行尾，不需要标量收尾
+__attribute__((target("avx512f")))
+void reactionRowAVX512(const float* temperature, const float* density, const float* velocityX, const float* velocityY,
+                       float* nextTemperature, float* nextDensity, float* nextVelocityX, float* nextVelocityY, int count) {
+    const __m512 thousand = _mm512_set1_ps(1000.0f);
+    const __m512 dt = _mm512_set1_ps(TIME_STEP);
+    const __m512 heat = _mm512_set1_ps(0.1f);
+    const __m512 growth = _mm512_set1_ps(1.001f);
+    for (int j = 0; j < count; j += 16) {
+        const __mmask16 m = (count - j >= 16) ? static_cast<__mmask16>(0xFFFF)
+                                              : static_cast<__mmask16>((1u << (count - j)) - 1);
+        // 掩码外的通道读到 0，0/0 得到的 NaN 不会写回
+        __m512 t = _mm512_maskz_loadu_ps(m, temperature + j);
+        __m512 rho = _mm512_maskz_loadu_ps(m, density + j);
+        __m512 pressure = _mm512_div_ps(_mm512_mul_ps(rho, t), thousand);
+        __m512 a = _mm512_mul_ps(_mm512_div_ps(pressure, rho), dt);
+        __m512 vx = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, velocityX + j), a);
+        __m512 vy = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, velocityY + j), a);
+        _mm512_mask_storeu_ps(nextVelocityX + j, m, vx);
+        _mm512_mask_storeu_ps(nextVelocityY + j, m, vy);
+        _mm512_mask_storeu_ps(nextTemperature + j, m, _mm512_add_ps(t, _mm512_add_ps(_mm512_mul_ps(heat, vx), _mm512_mul_ps(heat, vy))));
+        _mm512_mask_storeu_ps(nextDensity + j, m, _mm512_mul_ps(rho, growth));
+    }
+}
+
+__attribute__((target("avx512f")))
+void divergenceRowAVX512(const float* velocityX, const float* velocityY, int stride, float* f, int count, float scale) {
+    const __m512 s = _mm512_set1_ps(-scale);
+    for (int j = 0; j < count; j += 16) {
+        const __mmask16 m = (count - j >= 16) ? static_cast<__mmask16>(0xFFFF)
+                                              : static_cast<__mmask16>((1u << (count - j)) - 1);
+        __m512 sum = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, velocityX + j + 1), _mm512_maskz_loadu_ps(m, velocityX + j - 1));
+        sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(m, velocityY + j + stride));
+        sum = _mm512_sub_ps(sum, _mm512_maskz_loadu_ps(m, velocityY + j - stride));
+        _mm512_mask_storeu_ps(f + j, m, _mm512_mul_ps(s, sum));
+    }
+}
+
+__attribute__((target("avx512f")))
+void subtractGradientRowAVX512(const float* p, int stride, float* velocityX, float* velocityY, int count, float scale) {
+    const __m512 s = _mm512_set1_ps(scale);
+    for (int j = 0; j < count; j += 16) {
+        const __mmask16 m = (count - j >= 16) ? static_cast<__mmask16>(0xFFFF)
+                                              : static_cast<__mmask16>((1u << (count - j)) - 1);
+        __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, p + j + 1), _mm512_maskz_loadu_ps(m, p + j - 1));
+        __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, p + j + stride), _mm512_maskz_loadu_ps(m, p + j - stride));
+        _mm512_mask_storeu_ps(velocityX + j, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, velocityX + j), _mm512_mul_ps(s, dx)));
+        _mm512_mask_storeu_ps(velocityY + j, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, velocityY + j), _mm512_mul_ps(s, dy)));
+    }
+}
+
+#endif
+
+#if defined(__clang__)
+#pragma clang fp contract(on)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#ifdef CFD_X86_KERNELS
+const CFDKernels SSE42_KERNELS = {"sse4.2", reactionRowSSE42, divergenceRowSSE42, subtractGradientRowSSE42};
+const CFDKernels AVX2_KERNELS = {"avx2", reactionRowAVX2, divergenceRowAVX2, subtractGradientRowAVX2};
+const CFDKernels AVX512_KERNELS = {"avx512", reactionRowAVX512, divergenceRowAVX512, subtractGradientRowAVX512};
+#endif
+
+// 当前 CPU 支持的内核，按从宽到窄排列，最后一项总是标量参考实现
+std::vector<const CFDKernels*> availableKernels() {
+    std::vector<const CFDKernels*> kernels;
+#ifdef CFD_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) kernels.push_back(&AVX512_KERNELS);
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&AVX2_KERNELS);
+    if (__builtin_cpu_supports("sse4.2")) kernels.push_back(&SSE42_KERNELS);
+#endif
+    kernels.push_back(&SCALAR_KERNELS);
+    return kernels;
+}
+
+// 启动时按 CPUID 选择；name 非空时选择指定的指令集（不支持则抛出异常）
+const CFDKernels& selectKernels(const std::string& name = "") {
+    std::vector<const CFDKernels*> kernels = availableKernels();
+    if (name.empty()) return *kernels.front();
+    for (const CFDKernels* kernel : kernels) {
+        if (name == kernel->name) return *kernel;
+    }
+    throw std::invalid_argument("Instruction set not supported on this CPU: " + name);
+}
+
+// 边界条件：幽灵单元 = 符号 × 相邻内部单元（+1 为零法向梯度，-1 为壁面处取零）
+struct BoundarySigns {
+    float x; // 左右边界 (j = 0, nx - 1)
+    float y; // 下上边界 (i = 0, ny - 1)
+};
+
+const BoundarySigns SCALAR_BOUNDARY = {1.0f, 1.0f};
+const BoundarySigns VELOCITY_X_BOUNDARY = {-1.0f, 1.0f};
+const BoundarySigns VELOCITY_Y_BOUNDARY = {1.0f, -1.0f};
+
+void applyBoundary(float* field, int nx, int ny, BoundarySigns signs) {
+    for (int i = 1; i < ny - 1; ++i) {
+        field[i * nx] = signs.x * field[i * nx + 1];
+        field[i * nx + nx - 1] = signs.x * field[i * nx + nx - 2];
+    }
+    for (int j = 1; j < nx - 1; ++j) {
+        field[j] = signs.y * field[nx + j];
+        field[(ny - 1) * nx + j] = signs.y * field[(ny - 2) * nx + j];
+    }
+    const int top = (ny - 1) * nx;
+    field[0] = 0.5f * (field[1] + field[nx]);
+    field[nx - 1] = 0.5f * (field[nx - 2] + field[2 * nx - 1]);
+    field[top] = 0.5f * (field[top + 1] + field[top - nx]);
+    field[top + nx - 1] = 0.5f * (field[top + nx - 2] + field[top - 1]);
+}
+
+// 几何多重网格（单元中心、V 循环、红黑 Gauss-Seidel 光滑）
+// 求解内部单元上的 c0 * x - ∇²x = f；c0 = 0 时即压力泊松方程，c0 > 0 时为隐式扩散。
+// 粗网格按有限体积离散：每层记录两个方向各列/各行的单元宽度，粗化时相邻两个单元合并，
+// 奇数个单元时较宽一端的单元单独保留，差分系数、限制（按体积加权）和插值（按单元中心线性插值）都由宽度算出，
+// 因此任意尺寸的网格都能正确粗化。每层只粗化仍多于 COARSEST_SIZE 个内部单元、且名义间距小于另一方向两倍的方向
+// （半粗化），避免逐点光滑在强各向异性层上失效；最粗层用 Cholesky 直接求解
+class MultigridSolver {
 public:
-    CFDSimulation(std::vector<FluidCell>& initialGrid) 
-        : grid(initialGrid) {}
+    MultigridSolver(int nx, int ny, float hx, float hy, ThreadPool& pool)
+        : pool(pool), cycles(0), residual(0.0), converged(true) {
+        levels.push_back(Level(uniformAxis(nx - 2, hx), uniformAxis(ny - 2, hy), false));
+        for (;;) {
+            Level& fine = levels.back();
+            const int interiorX = fine.nx - 2;
+            const int interiorY = fine.ny - 2;
+            bool coarsenX = interiorX > COARSEST_SIZE && fine.ax.nominal < 2.0f * fine.ay.nominal;
+            bool coarsenY = interiorY > COARSEST_SIZE && fine.ay.nominal < 2.0f * fine.ax.nominal;
+            // 按间距比无法继续、但本层超过直接求解的规模上限时，仍粗化尚可粗化的方向
+            if (!coarsenX && !coarsenY && interiorX * interiorY > DIRECT_SOLVE_LIMIT) {
+                coarsenX = interiorX > COARSEST_SIZE;
+                coarsenY = interiorY > COARSEST_SIZE;
+            }
+            if (!coarsenX && !coarsenY) break;
+            Axis ax = coarsenAxis(fine.ax, coarsenX);
+            Axis ay = coarsenAxis(fine.ay, coarsenY);
+            levels.push_back(Level(std::move(ax), std::move(ay), true));
+        }
+    }
 
-    void update() {
-        // 使用简化的Navier-Stokes方程进行更新
-        for (int i = 1; i < GRID_SIZE - 1; ++i) {
-            for (int j = 1; j < GRID_SIZE - 1; ++j) {
-                // 简化的流体动力学计算
-                float pressure = (grid[i * GRID_SIZE + j].density * grid[i * GRID_SIZE + j].temperature) / 1000.0f;
+    // x 为初值并返回解（含幽灵单元）；pureNeumann 时去掉右端项和解的均值。
+    // 相对残差既未降到 TOLERANCE 以下、也未降到单精度舍入误差水平（达到循环上限或发散）时返回 false
+    bool solve(float* x, float* f, float c0, BoundarySigns signs, bool pureNeumann) {
+        Level& finest = levels[0];
+        finest.x = x;
+        finest.f = f;
+        if (pureNeumann) {
+            removeMean(finest, finest.f);
+        }
+
+        double fNorm = std::sqrt(sumSquares(finest, finest.f));
+        cycles = 0;
+        residual = 0.0;
+        if (fNorm == 0.0) fNorm = 1.0;
+
+        for (cycles = 1; cycles <= MAX_V_CYCLES; ++cycles) {
+            double previous = residual;
+            vCycle(0, c0, signs, pureNeumann);
+            computeResidual(finest, c0, signs);
+            residual = std::sqrt(sumSquares(finest, finest.r.data())) / fNorm;
+            // 达到容差，或已降到单精度舍入误差水平不再下降时停止
+            if (residual < TOLERANCE || (cycles > 1 && residual > STAGNATION * previous)) break;
+        }
+        if (cycles > MAX_V_CYCLES) cycles = MAX_V_CYCLES;
+        // 解以单精度保存，其舍入误差经算子放大后给出残差的下限（网格越细、解越光滑越高），
+        // 残差停在该下限以下也算收敛
+        converged = residual < TOLERANCE || residual < roundingResidual(finest, c0) / fNorm;
+
+        if (pureNeumann) {
+            removeMean(finest, finest.x);
+        }
+        applyBoundary(finest.x, finest.nx, finest.ny, signs);
+        return converged;
+    }
 
-                // 更新速度（动量守恒）
-                velocityX = grid[i * GRID_SIZE + j].velocityX - (pressure / grid[i * GRID_SIZE + j].density) * TIME_STEP;
-                velocityY = grid[i * GRID_SIZE + j].velocityY - (pressure / grid[i * GRID_SIZE + j].density) * TIME_STEP;
+    int lastCycles() const { return cycles; }
+    double lastResidual() const { return residual; }
+    bool lastConverged() const { return converged; }
+    std::size_t levelCount() const { return levels.size(); }
 
-                grid[i * GRID_SIZE + j].velocityX = velocityX;
-                grid[i * GRID_SIZE + j].velocityY = velocityY;
+private:
+    static const int COARSEST_SIZE = 4;   // 最粗层内部单元数上限
+    static const int PRE_SMOOTH = 2;
+    static const int POST_SMOOTH = 2;
+    static const int DIRECT_SOLVE_LIMIT = 256; // 最粗层直接求解的未知数上限
+    static const int MAX_V_CYCLES = 20;
+    static constexpr double TOLERANCE = 1e-4;
+    static constexpr double STAGNATION = 0.9;
+
+    // 最粗层矩阵的 Cholesky 因子（行主序下三角），按 c0、边界符号和是否纯 Neumann 缓存
+    struct CoarseFactor {
+        float c0;
+        BoundarySigns signs;
+        bool pureNeumann;
+        std::vector<double> lower;
+    };
 
-                // 更新温度
-                grid[i * GRID_SIZE + j].temperature += (0.1f * velocityX + 0.1f * velocityY); // 热源
+    // 一个方向上的单元划分，下标含两端的幽灵单元（幽灵单元与相邻内部单元等宽）
+    struct Axis {
+        float nominal;                  // 名义间距（细网格间距乘以粗化次数的 2 的幂）
+        bool uniform;                   // 所有单元等宽
+        std::vector<float> width;
+        std::vector<float> low, high;   // 与前一个 / 后一个单元的耦合系数 2 / (w_i (w_i + w_i±1))
+        std::vector<int> firstChild;    // 在细一层中的第一个子单元，末项为哨兵
+        std::vector<int> parent;        // 细一层单元 i 由本层 parent[i] 与 parent[i] + 1 线性插值
+        std::vector<float> weight;      // parent[i] + 1 的插值权重
+    };
 
-                // 更新密度
-                grid[i * GRID_SIZE + j].density *= 1.001f;  // 简化反应过程
+    struct Level {
+        int nx, ny;
+        Axis ax, ay;
+        FieldArray ownedX, ownedF, r;
+        float* x;
+        float* f;
+
+        Level(Axis ax, Axis ay, bool ownsSolution)
+            : nx(static_cast<int>(ax.width.size())), ny(static_cast<int>(ay.width.size())),
+              ax(std::move(ax)), ay(std::move(ay)), r(static_cast<std::size_t>(nx) * ny), x(nullptr), f(nullptr) {
+            if (ownsSolution) {
+                ownedX = FieldArray(static_cast<std::size_t>(nx) * ny);
+                ownedF = FieldArray(static_cast<std::size_t>(nx) * ny);
+                x = ownedX.data();
+                f = ownedF.data();
             }
         }
+    };
+
+    ThreadPool& pool;
+    std::vector<Level> levels;
+    std::vector<CoarseFactor> coarseFactors;
+    std::vector<double> coarseRhs;
+    int cycles;
+    double residual;
+    bool converged;
+
+    static void finishAxis(Axis& axis) {
+        const std::size_t n = axis.width.size();
+        axis.width.front() = axis.width[1];
+        axis.width.back() = axis.width[n - 2];
+        axis.uniform = std::all_of(axis.width.begin(), axis.width.end(), [&](float w) { return w == axis.width[1]; });
+        axis.low.assign(n, 0.0f);
+        axis.high.assign(n, 0.0f);
+        for (std::size_t i = 1; i + 1 < n; ++i) {
+            const double w = axis.width[i];
+            axis.low[i] = static_cast<float>(2.0 / (w * (axis.width[i - 1] + w)));
+            axis.high[i] = static_cast<float>(2.0 / (w * (w + axis.width[i + 1])));
+        }
+    }
+
+    static Axis uniformAxis(int interior, float h) {
+        Axis axis;
+        axis.nominal = h;
+        axis.width.assign(interior + 2, h);
+        finishAxis(axis);
+        return axis;
+    }
+
+    // 相邻两个单元合并为一个粗单元；单元数为奇数时较宽一端的单元单独成为粗单元，
+    // 使相邻粗单元的宽度比保持有界。同时在细层记录插值所需的粗单元下标与权重
+    static Axis coarsenAxis(Axis& fine, bool coarsen) {
+        const int n = static_cast<int>(fine.width.size()) - 2;
+        Axis coarse;
+        coarse.nominal = coarsen ? 2.0f * fine.nominal : fine.nominal;
+        coarse.width.push_back(0.0f);
+        coarse.firstChild.push_back(0);
+        const bool loneFirst = coarsen && (n & 1) && fine.width[1] >= fine.width[n];
+        const bool loneLast = coarsen && (n & 1) && !loneFirst;
+        for (int i = 1; i <= n;) {
+            const bool single = !coarsen || (loneFirst && i == 1) || (loneLast && i == n);
+            const int children = single ? 1 : 2;
+            coarse.firstChild.push_back(i);
+            coarse.width.push_back(fine.width[i] + (children == 2 ? fine.width[i + 1] : 0.0f));
+            i += children;
+        }
+        coarse.firstChild.push_back(n + 1);
+        coarse.width.push_back(0.0f);
+        finishAxis(coarse);
+
+        // 单元中心坐标（内部区域起点为 0），幽灵单元中心位于边界外半个单元处
+        auto centers = [](const Axis& axis) {
+            const std::size_t count = axis.width.size();
+            std::vector<double> center(count);
+            double edge = 0.0;
+            center[0] = -0.5 * axis.width[0];
+            for (std::size_t i = 1; i < count; ++i) {
+                center[i] = edge + 0.5 * axis.width[i];
+                edge += axis.width[i];
+            }
+            return center;
+        };
+        const std::vector<double> fineCenter = centers(fine);
+        const std::vector<double> coarseCenter = centers(coarse);
+        fine.parent.assign(n + 2, 0);
+        fine.weight.assign(n + 2, 0.0f);
+        for (int c = 1; c + 1 < static_cast<int>(coarse.width.size()); ++c) {
+            for (int i = coarse.firstChild[c]; i < coarse.firstChild[c + 1]; ++i) {
+                const int left = fineCenter[i] < coarseCenter[c] ? c - 1 : c;
+                fine.parent[i] = left;
+                fine.weight[i] = static_cast<float>((fineCenter[i] - coarseCenter[left]) /
+                                                    (coarseCenter[left + 1] - coarseCenter[left]));
+            }
+        }
+        return coarse;
+    }
+
+    void forInteriorRows(const Level& level, const std::function<void(int)>& body) {
+        pool.parallelFor(1, level.ny - 1, ROW_BLOCK, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) body(static_cast<int>(i));
+        });
+    }
+
+    // 按行求部分和再顺序相加，保证归约结果与线程数无关
+    double sumRows(const Level& level, const std::function<double(int)>& rowSum) {
+        std::vector<double> partial(level.ny, 0.0);
+        forInteriorRows(level, [&](int i) { partial[i] = rowSum(i); });
+        double total = 0.0;
+        for (double value : partial) total += value;
+        return total;
+    }
+
+    double sumSquares(const Level& level, const float* field) {
+        return sumRows(level, [&](int i) {
+            double sum = 0.0;
+            for (int j = 1; j < level.nx - 1; ++j) {
+                double value = field[i * level.nx + j];
+                sum += value * value;
+            }
+            return sum;
+        });
+    }
+
+    void removeMean(const Level& level, float* field) {
+        double total = sumRows(level, [&](int i) {
+            double sum = 0.0;
+            for (int j = 1; j < level.nx - 1; ++j) sum += field[i * level.nx + j];
+            return sum;
+        });
+        const float mean = static_cast<float>(total / ((level.nx - 2.0) * (level.ny - 2.0)));
+        forInteriorRows(level, [&](int i) {
+            for (int j = 1; j < level.nx - 1; ++j) field[i * level.nx + j] -= mean;
+        });
+    }
+
+    void relax(Level& level, float c0, BoundarySigns signs, int sweeps) {
+        const int nx = level.nx;
+        const float* west = level.ax.low.data();
+        const float* east = level.ax.high.data();
+        const float* south = level.ay.low.data();
+        const float* north = level.ay.high.data();
+        float* x = level.x;
+        const float* f = level.f;
+        // 等宽网格（最细层总是如此）的系数处处相同，用常数系数和预先求好的对角元倒数
+        const bool uniform = level.ax.uniform && level.ay.uniform;
+        const float invHx2 = west[1];
+        const float invHy2 = south[1];
+        const float invDiagonal = 1.0f / (c0 + 2.0f * invHx2 + 2.0f * invHy2);
+
+        for (int sweep = 0; sweep < sweeps; ++sweep) {
+            for (int color = 0; color < 2; ++color) {
+                applyBoundary(x, nx, level.ny, signs);
+                forInteriorRows(level, [&](int i) {
+                    const int first = 1 + ((i + 1 + color) & 1);
+                    if (uniform) {
+                        for (int j = first; j < nx - 1; j += 2) {
+                            const int k = i * nx + j;
+                            x[k] = (f[k] + invHx2 * (x[k - 1] + x[k + 1]) + invHy2 * (x[k - nx] + x[k + nx])) * invDiagonal;
+                        }
+                        return;
+                    }
+                    const float rowDiagonal = c0 + south[i] + north[i];
+                    for (int j = first; j < nx - 1; j += 2) {
+                        const int k = i * nx + j;
+                        x[k] = (f[k] + west[j] * x[k - 1] + east[j] * x[k + 1] + south[i] * x[k - nx] + north[i] * x[k + nx])
+                             / (rowDiagonal + west[j] + east[j]);
+                    }
+                });
+            }
+        }
+        applyBoundary(x, nx, level.ny, signs);
+    }
+
+    void computeResidual(Level& level, float c0, BoundarySigns signs) {
+        const int nx = level.nx;
+        const float* west = level.ax.low.data();
+        const float* east = level.ax.high.data();
+        const float* south = level.ay.low.data();
+        const float* north = level.ay.high.data();
+        const float* x = level.x;
+        const float* f = level.f;
+        float* r = level.r.data();
+
+        const bool uniform = level.ax.uniform && level.ay.uniform;
+        const float invHx2 = west[1];
+        const float invHy2 = south[1];
+
+        applyBoundary(level.x, nx, level.ny, signs);
+        forInteriorRows(level, [&](int i) {
+            if (uniform) {
+                for (int j = 1; j < nx - 1; ++j) {
+                    const int k = i * nx + j;
+                    float laplacian = (x[k - 1] + x[k + 1] - 2.0f * x[k]) * invHx2 + (x[k - nx] + x[k + nx] - 2.0f * x[k]) * invHy2;
+                    r[k] = f[k] - (c0 * x[k] - laplacian);
+                }
+                return;
+            }
+            for (int j = 1; j < nx - 1; ++j) {
+                const int k = i * nx + j;
+                float laplacian = west[j] * (x[k - 1] - x[k]) + east[j] * (x[k + 1] - x[k])
+                                + south[i] * (x[k - nx] - x[k]) + north[i] * (x[k + nx] - x[k]);
+                r[k] = f[k] - (c0 * x[k] - laplacian);
+            }
+        });
+    }
+
+    // 计算残差时各项绝对值之和乘以单精度机器精度，即残差中舍入误差的量级（2 范数）
+    double roundingResidual(const Level& level, float c0) {
+        const int nx = level.nx;
+        const float* west = level.ax.low.data();
+        const float* east = level.ax.high.data();
+        const float* south = level.ay.low.data();
+        const float* north = level.ay.high.data();
+        const float* x = level.x;
+        const double sum = sumRows(level, [&](int i) {
+            double rowSum = 0.0;
+            for (int j = 1; j < nx - 1; ++j) {
+                const int k = i * nx + j;
+                const double magnitude = (c0 + west[j] + east[j] + south[i] + north[i]) * std::fabs(x[k])
+                                       + west[j] * std::fabs(x[k - 1]) + east[j] * std::fabs(x[k + 1])
+                                       + south[i] * std::fabs(x[k - nx]) + north[i] * std::fabs(x[k + nx]);
+                rowSum += magnitude * magnitude;
+            }
+            return rowSum;
+        });
+        return std::numeric_limits<float>::epsilon() * std::sqrt(sum);
+    }
+
+    // 细网格残差按子单元体积加权平均限制到粗网格右端项（有限体积积分守恒）
+    void restrictResidual(const Level& fine, Level& coarse) {
+        const float* r = fine.r.data();
+        std::fill_n(coarse.x, static_cast<std::size_t>(coarse.nx) * coarse.ny, 0.0f);
+        forInteriorRows(coarse, [&](int ci) {
+            for (int cj = 1; cj < coarse.nx - 1; ++cj) {
+                float sum = 0.0f;
+                for (int fi = coarse.ay.firstChild[ci]; fi < coarse.ay.firstChild[ci + 1]; ++fi) {
+                    for (int fj = coarse.ax.firstChild[cj]; fj < coarse.ax.firstChild[cj + 1]; ++fj) {
+                        sum += r[fi * fine.nx + fj] * fine.ay.width[fi] * fine.ax.width[fj];
+                    }
+                }
+                coarse.f[ci * coarse.nx + cj] = sum / (coarse.ay.width[ci] * coarse.ax.width[cj]);
+            }
+        });
+    }
+
+    // 粗网格修正按单元中心在两个方向上线性插值加回细网格（含幽灵单元，因此边界条件自然满足）
+    void prolongAdd(const Level& coarse, Level& fine) {
+        const float* e = coarse.x;
+        forInteriorRows(fine, [&](int i) {
+            const int ci = fine.ay.parent[i];
+            const float wy = fine.ay.weight[i];
+            for (int j = 1; j < fine.nx - 1; ++j) {
+                const int cj = fine.ax.parent[j];
+                const float wx = fine.ax.weight[j];
+                const int k = ci * coarse.nx + cj;
+                const float lower = e[k] + wx * (e[k + 1] - e[k]);
+                const float upper = e[k + coarse.nx] + wx * (e[k + coarse.nx + 1] - e[k + coarse.nx]);
+                fine.x[i * fine.nx + j] += lower + wy * (upper - lower);
+            }
+        });
+    }
+
+    // 各行乘以单元体积后矩阵对称，再做 Cholesky 分解
+    const std::vector<double>& coarseFactor(const Level& level, float c0, BoundarySigns signs, bool pureNeumann) {
+        for (const CoarseFactor& factor : coarseFactors) {
+            if (factor.c0 == c0 && factor.signs.x == signs.x && factor.signs.y == signs.y
+                && factor.pureNeumann == pureNeumann) {
+                return factor.lower;
+            }
+        }
+
+        const int ix = level.nx - 2;
+        const int iy = level.ny - 2;
+        const int n = ix * iy;
+        const Axis& ax = level.ax;
+        const Axis& ay = level.ay;
+        // 纯 Neumann 问题矩阵奇异（常数为零空间），加上 1·1ᵀ 的倍数后解即为零均值解
+        const double meanPenalty = pureNeumann
+            ? static_cast<double>(ax.width[1]) * ay.width[1] * (ax.low[1] + ay.low[1]) / n : 0.0;
+        std::vector<double> a(static_cast<std::size_t>(n) * n, meanPenalty);
+        for (int i = 0; i < iy; ++i) {
+            for (int j = 0; j < ix; ++j) {
+                const int row = i * ix + j;
+                double* ar = &a[static_cast<std::size_t>(row) * n];
+                const double volume = static_cast<double>(ax.width[j + 1]) * ay.width[i + 1];
+                const double west = volume * ax.low[j + 1], east = volume * ax.high[j + 1];
+                const double south = volume * ay.low[i + 1], north = volume * ay.high[i + 1];
+                double diagonal = volume * c0 + west + east + south + north;
+                // 幽灵单元 = 符号 × 相邻内部单元，折算进对角元
+                if (j > 0) ar[row - 1] -= west; else diagonal -= signs.x * west;
+                if (j < ix - 1) ar[row + 1] -= east; else diagonal -= signs.x * east;
+                if (i > 0) ar[row - ix] -= south; else diagonal -= signs.y * south;
+                if (i < iy - 1) ar[row + ix] -= north; else diagonal -= signs.y * north;
+                ar[row] += diagonal;
+            }
+        }
+
+        for (int r = 0; r < n; ++r) {
+            double* ar = &a[static_cast<std::size_t>(r) * n];
+            for (int c = 0; c <= r; ++c) {
+                const double* ac = &a[static_cast<std::size_t>(c) * n];
+                double sum = ar[c];
+                for (int k = 0; k < c; ++k) sum -= ar[k] * ac[k];
+                if (c < r) {
+                    ar[c] = sum / ac[c];
+                } else {
+                    if (sum <= 0.0) throw std::runtime_error("Multigrid coarsest matrix is not positive definite");
+                    ar[r] = std::sqrt(sum);
+                }
+            }
+        }
+
+        coarseFactors.push_back(CoarseFactor{c0, signs, pureNeumann, std::move(a)});
+        return coarseFactors.back().lower;
+    }
+
+    void solveCoarsest(Level& level, float c0, BoundarySigns signs, bool pureNeumann) {
+        const std::vector<double>& lower = coarseFactor(level, c0, signs, pureNeumann);
+        const int ix = level.nx - 2;
+        const int n = ix * (level.ny - 2);
+        std::vector<double>& b = coarseRhs;
+        b.resize(n);
+        for (int r = 0; r < n; ++r) {
+            const int i = r / ix + 1, j = r % ix + 1;
+            b[r] = static_cast<double>(level.f[i * level.nx + j]) * level.ax.width[j] * level.ay.width[i];
+        }
+
+        // L y = b，再 Lᵀ x = y
+        for (int r = 0; r < n; ++r) {
+            const double* lr = &lower[static_cast<std::size_t>(r) * n];
+            double sum = b[r];
+            for (int k = 0; k < r; ++k) sum -= lr[k] * b[k];
+            b[r] = sum / lr[r];
+        }
+        for (int r = n - 1; r >= 0; --r) {
+            double sum = b[r];
+            for (int k = r + 1; k < n; ++k) sum -= lower[static_cast<std::size_t>(k) * n + r] * b[k];
+            b[r] = sum / lower[static_cast<std::size_t>(r) * n + r];
+        }
+
+        for (int r = 0; r < n; ++r) level.x[(r / ix + 1) * level.nx + r % ix + 1] = static_cast<float>(b[r]);
+    }
+
+    void vCycle(std::size_t l, float c0, BoundarySigns signs, bool pureNeumann) {
+        Level& level = levels[l];
+        if (l + 1 == levels.size()) {
+            solveCoarsest(level, c0, signs, pureNeumann);
+            if (pureNeumann) removeMean(level, level.x);
+            return;
+        }
+
+        Level& coarse = levels[l + 1];
+        relax(level, c0, signs, PRE_SMOOTH);
+        computeResidual(level, c0, signs);
+        restrictResidual(level, coarse);
+        vCycle(l + 1, c0, signs, pureNeumann);
+        applyBoundary(coarse.x, coarse.nx, coarse.ny, signs);
+        prolongAdd(coarse, level);
+        relax(level, c0, signs, POST_SMOOTH);
+    }
+};
+
+enum class SolverType {
+    Simplified,   // 原有的简化逐点模型
+    StableFluids  // 不可压缩 Navier-Stokes：半拉格朗日平流 + 隐式扩散 + 压力投影
+};
+
+struct FluidParameters {
+    float viscosity = 1e-4f;   // 运动粘度
+    float diffusivity = 1e-5f; // 温度与密度的扩散系数
+    float buoyancy = 0.0f;     // Boussinesq 浮力系数（作用于 y 方向）
+};
+
+class CFDSimulation {
+public:
+    CFDSimulation(int nx, int ny, unsigned threads = 1,
+                  SolverType solver = SolverType::Simplified, FluidParameters parameters = FluidParameters())
+        : fields(nx, ny), scratch(nx, ny), pool(threads), kernels(&selectKernels()),
+          solver(solver), parameters(parameters), cellSize(1.0f / (std::max(nx, ny) - 2)), stepCount(0),
+          failedSolves(0) {
+        if (solver == SolverType::StableFluids) {
+            pressure = FieldArray(fields.cells());
+            rhs = FieldArray(fields.cells());
+            multigrid.reset(new MultigridSolver(nx, ny, cellSize, cellSize, pool));
+        }
+    }
+
+    void update() {
+        ++stepCount;
+        if (solver == SolverType::StableFluids) {
+            stableFluidsStep();
+            return;
+        }
+        // 从 fields 读取、写入 scratch，然后交换两套缓冲区；
+        // 每个单元只依赖上一步的数据，因此结果与遍历顺序和线程数无关
+        pool.parallelFor(0, fields.ny, ROW_BLOCK, [this](std::size_t rowBegin, std::size_t rowEnd) {
+            updateRows(static_cast<int>(rowBegin), static_cast<int>(rowEnd));
+        });
+        std::swap(fields, scratch);
     }
 
     void simulate(int steps) {
         for (int step = 0; step < steps; ++step) {
             update();
-            render();
         }
     }
 
-    void render() const {
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        for (int i = 0; i < GRID_SIZE; ++i) {
-            for (int j = 0; j < GRID_SIZE; ++j) {
-                float temp = grid[i * GRID_SIZE + j].temperature;
-                float dens = grid[i * GRID_SIZE + j].density;
+    unsigned threads() const { return pool.size(); }
+    std::uint64_t steps() const { return stepCount; }
+    void setStepCount(std::uint64_t count) { stepCount = count; }
+    // 稳定流体求解器的压力场（作为下一步的初值，需要随检查点保存）；简化模型返回 nullptr
+    FieldArray* pressureField() { return pressure.count() ? &pressure : nullptr; }
+    const FieldArray* pressureField() const { return pressure.count() ? &pressure : nullptr; }
+    ThreadPool& threadPool() { return pool; }
+    void setKernels(const CFDKernels& selected) { kernels = &selected; }
+    const CFDKernels& activeKernels() const { return *kernels; }
+    const MultigridSolver* pressureSolver() const { return multigrid.get(); }
+    std::uint64_t unconvergedSolves() const { return failedSolves; }
+    SolverType solverType() const { return solver; }
+    FluidFields& state() { return fields; }
+    const FluidFields& state() const { return fields; }
 
-                // 颜色映射
-                glColor3f(temp / 100.0f, 0.0f, dens / 1000.0f);
-                
-                // 绘制矩形
-                glBegin(GL_QUADS);
-                glVertex2f(i * 0.1f, j * 0.1f); 
-                glVertex2f(i * 0.1f, (j + 1) * 0.1f); 
-                glVertex2f((i + 1) * 0.1f, (j + 1) * 0.1f); 
-                glVertex2f((i + 1) * 0.1f, j * 0.1f); 
-                glEnd();
+private:
+    FluidFields fields;  // 当前时间步（只读）
+    FluidFields scratch; // 下一时间步（只写）
+    ThreadPool pool;
+    const CFDKernels* kernels;
+    SolverType solver;
+    FluidParameters parameters;
+    float cellSize;
+    FieldArray pressure; // 上一步的压力，作为下一次求解的初值
+    FieldArray rhs;
+    std::unique_ptr<MultigridSolver> multigrid;
+    std::uint64_t stepCount;
+    std::uint64_t failedSolves; // 未收敛的多重网格求解次数
+
+    void forInteriorRows(const std::function<void(int)>& body) {
+        pool.parallelFor(1, fields.ny - 1, ROW_BLOCK, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) body(static_cast<int>(i));
+        });
+    }
+
+    // Stam 稳定流体：fields 为 t 时刻，结果写入 scratch 后交换
+    void stableFluidsStep() {
+        const float dt = TIME_STEP;
+
+        advect(scratch.velocityX.data(), fields.velocityX.data(), fields.velocityX.data(), fields.velocityY.data(), VELOCITY_X_BOUNDARY);
+        advect(scratch.velocityY.data(), fields.velocityY.data(), fields.velocityX.data(), fields.velocityY.data(), VELOCITY_Y_BOUNDARY);
+
+        if (parameters.buoyancy != 0.0f) {
+            const float* temperature = fields.temperature.data();
+            float* velocityY = scratch.velocityY.data();
+            forInteriorRows([&](int i) {
+                for (int j = 1; j < fields.nx - 1; ++j) {
+                    velocityY[fields.index(i, j)] += dt * parameters.buoyancy * temperature[fields.index(i, j)];
+                }
+            });
+        }
+
+        diffuse(scratch.velocityX.data(), parameters.viscosity, VELOCITY_X_BOUNDARY);
+        diffuse(scratch.velocityY.data(), parameters.viscosity, VELOCITY_Y_BOUNDARY);
+        project(scratch.velocityX.data(), scratch.velocityY.data());
+
+        // 标量随无散速度场平流，再隐式扩散
+        advect(scratch.temperature.data(), fields.temperature.data(), scratch.velocityX.data(), scratch.velocityY.data(), SCALAR_BOUNDARY);
+        advect(scratch.density.data(), fields.density.data(), scratch.velocityX.data(), scratch.velocityY.data(), SCALAR_BOUNDARY);
+        diffuse(scratch.temperature.data(), parameters.diffusivity, SCALAR_BOUNDARY);
+        diffuse(scratch.density.data(), parameters.diffusivity, SCALAR_BOUNDARY);
+
+        std::swap(fields, scratch);
+    }
+
+    // 半拉格朗日平流：沿速度回溯一个时间步并双线性插值
+    void advect(float* destination, const float* source, const float* velocityX, const float* velocityY,
+                BoundarySigns signs) {
+        const int nx = fields.nx;
+        const int ny = fields.ny;
+        const float cells = TIME_STEP / cellSize;
+        forInteriorRows([&](int i) {
+            for (int j = 1; j < nx - 1; ++j) {
+                const std::size_t k = fields.index(i, j);
+                float x = std::min(std::max(j - cells * velocityX[k], 0.5f), nx - 1.5f);
+                float y = std::min(std::max(i - cells * velocityY[k], 0.5f), ny - 1.5f);
+                int j0 = static_cast<int>(x);
+                int i0 = static_cast<int>(y);
+                float s = x - j0;
+                float t = y - i0;
+                const float* row0 = source + fields.index(i0, j0);
+                const float* row1 = row0 + nx;
+                destination[k] = (1.0f - t) * ((1.0f - s) * row0[0] + s * row0[1])
+                               + t * ((1.0f - s) * row1[0] + s * row1[1]);
+            }
+        });
+        applyBoundary(destination, nx, ny, signs);
+    }
+
+    // 隐式扩散 (I - κ dt ∇²) q = q*，写成 c0 q - ∇²q = c0 q*，c0 = 1 / (κ dt)
+    void diffuse(float* field, float coefficient, BoundarySigns signs) {
+        if (coefficient <= 0.0f) return;
+        const float c0 = 1.0f / (coefficient * TIME_STEP);
+        float* f = rhs.data();
+        forInteriorRows([&](int i) {
+            for (int j = 1; j < fields.nx - 1; ++j) f[fields.index(i, j)] = c0 * field[fields.index(i, j)];
+        });
+        if (!multigrid->solve(field, f, c0, signs, false)) ++failedSolves;
+    }
+
+    // 压力投影：解 ∇²p = ∇·u（纯 Neumann 边界），再减去压力梯度
+    void project(float* velocityX, float* velocityY) {
+        const int nx = fields.nx;
+        const float halfInvH = 0.5f / cellSize;
+        float* f = rhs.data();
+        float* p = pressure.data();
+
+        forInteriorRows([&](int i) {
+            const std::size_t k = fields.index(i, 1);
+            kernels->divergenceRow(velocityX + k, velocityY + k, nx, f + k, nx - 2, halfInvH);
+        });
+        if (!multigrid->solve(p, f, 0.0f, SCALAR_BOUNDARY, true)) ++failedSolves;
+
+        forInteriorRows([&](int i) {
+            const std::size_t k = fields.index(i, 1);
+            kernels->subtractGradientRow(p + k, nx, velocityX + k, velocityY + k, nx - 2, halfInvH);
+        });
+        applyBoundary(velocityX, nx, fields.ny, VELOCITY_X_BOUNDARY);
+        applyBoundary(velocityY, nx, fields.ny, VELOCITY_Y_BOUNDARY);
+    }
+
+    void copyRow(int i) {
+        const std::size_t offset = fields.index(i, 0);
+        std::copy_n(fields.temperature.data() + offset, fields.nx, scratch.temperature.data() + offset);
+        std::copy_n(fields.density.data() + offset, fields.nx, scratch.density.data() + offset);
+        std::copy_n(fields.velocityX.data() + offset, fields.nx, scratch.velocityX.data() + offset);
+        std::copy_n(fields.velocityY.data() + offset, fields.nx, scratch.velocityY.data() + offset);
+    }
+
+    void updateRows(int rowBegin, int rowEnd) {
+        const int nx = fields.nx;
+        for (int i = rowBegin; i < rowEnd; ++i) {
+            // 边界单元保持不变
+            if (i == 0 || i == fields.ny - 1) {
+                copyRow(i);
+                continue;
             }
+
+            const std::size_t offset = fields.index(i, 0);
+            const float* __restrict temperature = fields.temperature.data() + offset;
+            const float* __restrict density = fields.density.data() + offset;
+            const float* __restrict velocityX = fields.velocityX.data() + offset;
+            const float* __restrict velocityY = fields.velocityY.data() + offset;
+            float* __restrict nextTemperature = scratch.temperature.data() + offset;
+            float* __restrict nextDensity = scratch.density.data() + offset;
+            float* __restrict nextVelocityX = scratch.velocityX.data() + offset;
+            float* __restrict nextVelocityY = scratch.velocityY.data() + offset;
+
+            for (int j = 0; j < nx; j += nx - 1) {
+                nextTemperature[j] = temperature[j];
+                nextDensity[j] = density[j];
+                nextVelocityX[j] = velocityX[j];
+                nextVelocityY[j] = velocityY[j];
+            }
+
+            // 使用简化的Navier-Stokes方程进行更新
+            kernels->reactionRow(temperature + 1, density + 1, velocityX + 1, velocityY + 1,
+                                 nextTemperature + 1, nextDensity + 1, nextVelocityX + 1, nextVelocityY + 1, nx - 2);
         }
+    }
+};
 
-        glFlush();
+// 只读内存映射文件（Windows 上退化为一次性读入对齐缓冲区）。
+// writable 为 true 时使用私有写时复制映射，映射的页可直接作为求解器的场数组。
+class MappedFile {
+public:
+    MappedFile(const std::string& filename, bool writable) : address(nullptr), length(0) {
+#ifdef _WIN32
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("Cannot open file: " + filename);
+        length = static_cast<std::size_t>(file.tellg());
+        buffer = FieldArray((length + sizeof(float) - 1) / sizeof(float));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer.data()), length);
+        address = buffer.data();
+        (void)writable;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open file: " + filename);
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat file: " + filename);
+        }
+        length = static_cast<std::size_t>(info.st_size);
+        if (length > 0) {
+            int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+            address = ::mmap(nullptr, length, protection, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                address = nullptr;
+                ::close(fd);
+                throw std::runtime_error("Cannot map file: " + filename);
+            }
+            ::madvise(address, length, writable ? MADV_WILLNEED : MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (address) ::munmap(address, length);
+#endif
     }
 
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* data() { return static_cast<char*>(address); }
+    const char* begin() const { return static_cast<const char*>(address); }
+    const char* end() const { return static_cast<const char*>(address) + length; }
+    std::size_t size() const { return length; }
+
 private:
-    std::vector<FluidCell> grid;
-};
-
-std::vector<FluidCell> loadInitialGrid(const std::string& filename) {
-    std::vector<FluidCell> initialGrid(GRID_SIZE * GRID_SIZE);
-    std::ifstream file(filename);
-    std::string line;
-
-    if (std::getline(file, line)) {
-        for (int i = 0; i < GRID_SIZE; ++i) {
-            if (std::getline(file, line)) {
-                std::istringstream ss(line);
-                std::string tempStr, densStr;
-                float temperature = 0.0, density = 0.0;
-                if (std::getline(ss, tempStr, ',') && std::getline(ss, densStr, ',')) {
-                    temperature = std::stof(tempStr);
-                    density = std::stof(densStr);
+    void* address;
+    std::size_t length;
+#ifdef _WIN32
+    FieldArray buffer;
+#endif
+};
+
+// 无分配的十进制浮点数解析（[+-]digits[.digits][(e|E)[+-]digits]），失败时返回 false 且不移动 p
+inline bool parseFloat(const char*& p, const char* end, float& value) {
+    static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char* s = p;
+    while (s < end && (*s == ' ' || *s == '\t')) ++s;
+
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = (*s++ == '-');
+
+    std::uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+        if (mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*s - '0');
+        else ++exponent;
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s, ++digits) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*s - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0) return false;
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* e = s + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) negativeExponent = (*e++ == '-');
+        if (e < end && *e >= '0' && *e <= '9') {
+            int explicitExponent = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; ++e) {
+                if (explicitExponent < 10000) explicitExponent = explicitExponent * 10 + (*e - '0');
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            s = e;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        result = (exponent >= -22) ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+    } else if (exponent > 0) {
+        result = (exponent <= 22) ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+    }
+    value = static_cast<float>(negative ? -result : result);
+    p = s;
+    return true;
+}
+
+// 解析一行 "temperature,density[,velocityX,velocityY]"，返回读到的数值个数，p 移到下一行开头
+inline int parseCsvLine(const char*& p, const char* end, float* values, int maxValues) {
+    int count = 0;
+    while (count < maxValues && parseFloat(p, end, values[count])) {
+        ++count;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        if (p < end && *p == ',') ++p;
+        else break;
+    }
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    p = newline ? newline + 1 : end;
+    return count;
+}
+
+// 二进制场文件格式（小端）：文件头之后按列存放各场的 float 数组，
+// 顺序为 temperature, density, velocityX, velocityY，每个数组起始偏移按 FIELD_ALIGNMENT 对齐，
+// 因此以写时复制方式映射后可直接作为求解器数组使用（零拷贝）
+const char FIELD_FILE_MAGIC[4] = {'C', 'F', 'D', 'F'};
+const std::uint32_t FIELD_FILE_VERSION = 1;
+const std::uint32_t FIELD_FILE_FIELDS = 4;
+
+struct FieldFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t nx;
+    std::uint32_t ny;
+    std::uint32_t fieldCount;
+    std::uint32_t reserved;
+    std::uint64_t dataOffset;  // 第一个场数组的字节偏移
+    std::uint64_t fieldStride; // 相邻场数组之间的字节距离
+};
+
+inline std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool readFieldFileHeader(const MappedFile& file, FieldFileHeader& header) {
+    if (file.size() < sizeof(FieldFileHeader) || std::memcmp(file.begin(), FIELD_FILE_MAGIC, 4) != 0) {
+        return false;
+    }
+    std::memcpy(&header, file.begin(), sizeof(header));
+    const std::uint64_t cells = static_cast<std::uint64_t>(header.nx) * header.ny;
+    if (header.version != FIELD_FILE_VERSION || header.fieldCount != FIELD_FILE_FIELDS ||
+        header.dataOffset % FIELD_ALIGNMENT != 0 || header.fieldStride % FIELD_ALIGNMENT != 0 ||
+        header.fieldStride < cells * sizeof(float) ||
+        header.dataOffset + header.fieldStride * (FIELD_FILE_FIELDS - 1) + cells * sizeof(float) > file.size()) {
+        throw std::runtime_error("Malformed binary field file");
+    }
+    return true;
+}
+
+// 若文件是二进制场文件则返回 true 并给出网格尺寸
+bool probeFieldFile(const std::string& filename, int& nx, int& ny) {
+    std::ifstream file(filename, std::ios::binary);
+    FieldFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, FIELD_FILE_MAGIC, 4) != 0) {
+        return false;
+    }
+    nx = static_cast<int>(header.nx);
+    ny = static_cast<int>(header.ny);
+    return true;
+}
+
+void saveFieldFile(const std::string& filename, const FluidFields& fields) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open file for writing: " + filename);
+
+    const std::uint64_t fieldBytes = fields.cells() * sizeof(float);
+    FieldFileHeader header;
+    std::memcpy(header.magic, FIELD_FILE_MAGIC, 4);
+    header.version = FIELD_FILE_VERSION;
+    header.nx = static_cast<std::uint32_t>(fields.nx);
+    header.ny = static_cast<std::uint32_t>(fields.ny);
+    header.fieldCount = FIELD_FILE_FIELDS;
+    header.reserved = 0;
+    header.dataOffset = alignUp(sizeof(header), 4096);
+    header.fieldStride = alignUp(fieldBytes, FIELD_ALIGNMENT);
+
+    const char padding[4096] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.dataOffset - sizeof(header));
+    const FieldArray* arrays[] = {&fields.temperature, &fields.density, &fields.velocityX, &fields.velocityY};
+    for (const FieldArray* array : arrays) {
+        file.write(reinterpret_cast<const char*>(array->data()), fieldBytes);
+        file.write(padding, header.fieldStride - fieldBytes);
+    }
+    if (!file) throw std::runtime_error("Failed writing binary field file: " + filename);
+}
+
+// 并行解析逐单元 CSV：先按块统计行数得到每块的起始单元，再各块独立解析
+void parseCellCsv(const char* begin, const char* end, FluidFields& fields, ThreadPool& pool) {
+    const std::size_t CHUNK_BYTES = 1 << 22;
+    std::vector<const char*> chunkStarts(1, begin);
+    for (const char* p = begin + CHUNK_BYTES; p < end; p += CHUNK_BYTES) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!newline) break;
+        p = newline + 1;
+        chunkStarts.push_back(p);
+    }
+    chunkStarts.push_back(end);
+    const std::size_t chunks = chunkStarts.size() - 1;
+
+    std::vector<std::size_t> firstCell(chunks + 1, 0);
+    pool.parallelFor(0, chunks, 1, [&](std::size_t c, std::size_t) {
+        std::size_t lines = 0;
+        for (const char* p = chunkStarts[c]; p < chunkStarts[c + 1]; ++lines) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', chunkStarts[c + 1] - p));
+            p = newline ? newline + 1 : chunkStarts[c + 1];
+        }
+        firstCell[c + 1] = lines;
+    });
+    for (std::size_t c = 0; c < chunks; ++c) firstCell[c + 1] += firstCell[c];
+
+    float* arrays[] = {fields.temperature.data(), fields.density.data(), fields.velocityX.data(), fields.velocityY.data()};
+    pool.parallelFor(0, chunks, 1, [&](std::size_t c, std::size_t) {
+        std::size_t cell = firstCell[c];
+        for (const char* p = chunkStarts[c]; p < chunkStarts[c + 1] && cell < fields.cells(); ++cell) {
+            float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            parseCsvLine(p, chunkStarts[c + 1], values, 4);
+            for (int f = 0; f < 4; ++f) arrays[f][cell] = values[f];
+        }
+    });
+}
+
+// 读取初始条件。二进制场文件直接映射为求解器数组；CSV 文件首行为表头，
+// 数据行数（不计末尾的空行）等于 nx*ny 时逐单元读取（行主序），否则第 i 行的值填满网格第 i 行。
+// 注意：文件不存在或无法打开时抛出 std::runtime_error（原实现会静默地以全零场开始）
+void loadInitialGrid(const std::string& filename, FluidFields& fields, ThreadPool& pool) {
+    std::shared_ptr<MappedFile> file(new MappedFile(filename, true));
+
+    FieldFileHeader header;
+    if (readFieldFileHeader(*file, header)) {
+        if (static_cast<int>(header.nx) != fields.nx || static_cast<int>(header.ny) != fields.ny) {
+            throw std::runtime_error("Binary field file size does not match the grid");
+        }
+        FieldArray* arrays[] = {&fields.temperature, &fields.density, &fields.velocityX, &fields.velocityY};
+        for (std::uint32_t f = 0; f < FIELD_FILE_FIELDS; ++f) {
+            float* data = reinterpret_cast<float*>(file->data() + header.dataOffset + f * header.fieldStride);
+            *arrays[f] = FieldArray(file, data, fields.cells());
+        }
+        return;
+    }
+
+    const char* p = file->begin();
+    const char* end = file->end();
+    // 末尾的空行（含 CRLF 和只有空白的行）不算数据行
+    while (end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) --end;
+    const char* firstLine = p;
+    float probe;
+    if (!parseFloat(firstLine, end, probe)) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = newline ? newline + 1 : end; // 跳过表头
+    }
+
+    std::size_t lines = 0;
+    for (const char* q = p; q < end; ++lines) {
+        const char* newline = static_cast<const char*>(std::memchr(q, '\n', end - q));
+        q = newline ? newline + 1 : end;
+    }
+
+    if (lines == fields.cells()) {
+        parseCellCsv(p, end, fields, pool);
+        return;
+    }
+
+    for (int i = 0; i < fields.ny && p < end; ++i) {
+        float values[2] = {0.0f, 0.0f};
+        parseCsvLine(p, end, values, 2);
+        std::fill_n(fields.temperature.data() + fields.index(i, 0), fields.nx, values[0]);
+        std::fill_n(fields.density.data() + fields.index(i, 0), fields.nx, values[1]);
+    }
+}
+
+// 快照 / 检查点文件格式（小端）：
+//   SnapshotHeader | SnapshotChunk 索引表 | 块数据
+// 每个场按 tileSize x tileSize 切块（行主序存放），索引表按场、再按块的行主序排列，
+// 读取方只需读取头和索引，就能按需取出单个场或任意子区域。
+// codec 为 SNAPSHOT_DEFLATE 时每块先做字节重排（把各 float 的同位字节放在一起）再用 zlib 压缩。
+const char SNAPSHOT_MAGIC[4] = {'C', 'F', 'D', 'S'};
+const std::uint32_t SNAPSHOT_VERSION = 2;
+const int SNAPSHOT_TILE_SIZE = 256;
+const std::uint32_t SNAPSHOT_MAX_TILE_SIZE = 16384; // 块的原始字节数须能放进 32 位
+
+enum SnapshotCodec : std::uint32_t { SNAPSHOT_RAW = 0, SNAPSHOT_DEFLATE = 1 };
+
+enum SnapshotField { TEMPERATURE_FIELD, DENSITY_FIELD, VELOCITY_X_FIELD, VELOCITY_Y_FIELD, PRESSURE_FIELD, SNAPSHOT_FIELD_COUNT };
+const char* const SNAPSHOT_FIELD_NAMES[SNAPSHOT_FIELD_COUNT] = {"temperature", "density", "velocityX", "velocityY", "pressure"};
+
+struct SnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t nx;
+    std::uint32_t ny;
+    std::uint32_t fieldMask; // 第 f 位表示包含 SnapshotField f
+    std::uint32_t tileSize;
+    std::uint32_t codec;
+    std::uint32_t solver;    // 写入时的 SolverType，恢复时必须与当前求解器一致
+    std::uint64_t step;
+    double time;
+};
+
+struct SnapshotChunk {
+    std::uint64_t offset;
+    std::uint32_t storedBytes;
+    std::uint32_t rawBytes;
+};
+
+int fieldFromName(const std::string& name) {
+    for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+        if (name == SNAPSHOT_FIELD_NAMES[f]) return f;
+    }
+    throw std::invalid_argument("Unknown field: " + name);
+}
+
+// 只读取请求的块，不需要读入整个文件
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& filename) : file(filename, std::ios::binary) {
+        if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, SNAPSHOT_MAGIC, 4) != 0 || header.version != SNAPSHOT_VERSION) {
+            throw std::runtime_error("Not a snapshot file: " + filename);
+        }
+        if (header.tileSize == 0 || header.tileSize > SNAPSHOT_MAX_TILE_SIZE || header.nx == 0 || header.ny == 0) {
+            throw std::runtime_error("Malformed snapshot header: " + filename);
+        }
+        tilesX = (header.nx + header.tileSize - 1) / header.tileSize;
+        tilesY = (header.ny + header.tileSize - 1) / header.tileSize;
+        for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+            firstChunk[f] = -1;
+            if (header.fieldMask & (1u << f)) {
+                firstChunk[f] = static_cast<int>(index.size());
+                index.resize(index.size() + static_cast<std::size_t>(tilesX) * tilesY);
+            }
+        }
+        if (!file.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(SnapshotChunk))) {
+            throw std::runtime_error("Truncated snapshot index: " + filename);
+        }
+    }
+
+    int width() const { return static_cast<int>(header.nx); }
+    int height() const { return static_cast<int>(header.ny); }
+    std::uint64_t step() const { return header.step; }
+    double time() const { return header.time; }
+    int tileSize() const { return static_cast<int>(header.tileSize); }
+    std::uint32_t solver() const { return header.solver; }
+    bool hasField(int field) const { return field >= 0 && field < SNAPSHOT_FIELD_COUNT && firstChunk[field] >= 0; }
+
+    // 读取 field 中从 (i0, j0) 开始的 rows x cols 区域到 out（行主序，行长为 cols）
+    void readRegion(int field, int i0, int j0, int rows, int cols, float* out) {
+        if (!hasField(field)) throw std::runtime_error(std::string("Snapshot has no field ") + SNAPSHOT_FIELD_NAMES[field]);
+        if (i0 < 0 || j0 < 0 || rows < 0 || cols < 0 || i0 + rows > height() || j0 + cols > width()) {
+            throw std::out_of_range("Snapshot region out of range");
+        }
+        const int tile = static_cast<int>(header.tileSize);
+        for (int ti = i0 / tile; rows > 0 && ti <= (i0 + rows - 1) / tile; ++ti) {
+            for (int tj = j0 / tile; cols > 0 && tj <= (j0 + cols - 1) / tile; ++tj) {
+                const int tileRows = std::min(tile, height() - ti * tile);
+                const int tileCols = std::min(tile, width() - tj * tile);
+                readTile(firstChunk[field] + ti * tilesX + tj, tileRows * tileCols);
+
+                const int rowBegin = std::max(i0, ti * tile);
+                const int rowEnd = std::min(i0 + rows, ti * tile + tileRows);
+                const int colBegin = std::max(j0, tj * tile);
+                const int colEnd = std::min(j0 + cols, tj * tile + tileCols);
+                for (int i = rowBegin; i < rowEnd; ++i) {
+                    std::copy(tileData.begin() + (i - ti * tile) * tileCols + (colBegin - tj * tile),
+                              tileData.begin() + (i - ti * tile) * tileCols + (colEnd - tj * tile),
+                              out + static_cast<std::size_t>(i - i0) * cols + (colBegin - j0));
                 }
-                initialGrid[i * GRID_SIZE] = FluidCell(temperature, density);
-                for (int j = 1; j < GRID_SIZE; ++j) {
-                    initialGrid[i * GRID_SIZE + j] = FluidCell(temperature, density);
+            }
+        }
+    }
+
+private:
+    std::ifstream file;
+    SnapshotHeader header;
+    std::vector<SnapshotChunk> index;
+    int firstChunk[SNAPSHOT_FIELD_COUNT];
+    int tilesX, tilesY;
+    std::vector<float> tileData;
+    std::vector<char> stored;
+    std::vector<char> shuffled;
+
+    void readTile(int chunk, int cells) {
+        const SnapshotChunk& entry = index[chunk];
+        if (entry.rawBytes != cells * sizeof(float)) throw std::runtime_error("Corrupt snapshot chunk");
+        tileData.resize(cells);
+        stored.resize(entry.storedBytes);
+        file.seekg(static_cast<std::streamoff>(entry.offset));
+        if (!file.read(stored.data(), entry.storedBytes)) throw std::runtime_error("Truncated snapshot chunk");
+
+        if (header.codec == SNAPSHOT_RAW) {
+            std::memcpy(tileData.data(), stored.data(), entry.rawBytes);
+            return;
+        }
+#ifdef CFD_WITH_ZLIB
+        shuffled.resize(entry.rawBytes);
+        uLongf length = entry.rawBytes;
+        if (uncompress(reinterpret_cast<Bytef*>(shuffled.data()), &length,
+                       reinterpret_cast<const Bytef*>(stored.data()), entry.storedBytes) != Z_OK || length != entry.rawBytes) {
+            throw std::runtime_error("Corrupt compressed snapshot chunk");
+        }
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(tileData.data());
+        for (int b = 0; b < 4; ++b) {
+            for (int k = 0; k < cells; ++k) bytes[4 * k + b] = shuffled[b * cells + k];
+        }
+#else
+        throw std::runtime_error("Compressed snapshots require building with CFD_WITH_ZLIB");
+#endif
+    }
+};
+
+// 在后台线程上写快照和检查点：复制线程把场复制到预分配的槽位中，I/O 线程负责编码写盘。
+// 提交的场在复制完成（awaitCopies）之前不能被修改；压力场由求解器原地更新，仍在提交时同步复制。
+// 槽位全部在使用时快照被丢弃（计数），检查点则等待空闲槽位，保证不丢失。
+class SnapshotWriter {
+public:
+    SnapshotWriter(int nx, int ny, SolverType solver, bool compress, unsigned slots = 2)
+        : nx(nx), ny(ny), solver(static_cast<std::uint32_t>(solver)), codec(compress ? SNAPSHOT_DEFLATE : SNAPSHOT_RAW),
+          stopping(false), copiesInFlight(0), droppedCount(0) {
+#ifndef CFD_WITH_ZLIB
+        if (compress) throw std::runtime_error("Snapshot compression requires building with CFD_WITH_ZLIB");
+#endif
+        for (unsigned s = 0; s < std::max(1u, slots); ++s) {
+            slotStorage.emplace_back(new Job);
+            freeSlots.push_back(slotStorage.back().get());
+        }
+        copier = std::thread(&SnapshotWriter::copierLoop, this);
+        worker = std::thread(&SnapshotWriter::writerLoop, this);
+    }
+
+    ~SnapshotWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        copier.join();
+        worker.join();
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // pressure 可为空；checkpoint 为 true 时先写临时文件再改名，保证文件总是完整的
+    bool submit(const FluidFields& fields, const FieldArray* pressure, std::uint64_t step,
+                const std::string& path, bool checkpoint) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (freeSlots.empty() && !checkpoint) {
+                ++droppedCount;
+                return false;
+            }
+            changed.wait(lock, [this] { return !freeSlots.empty(); });
+            job = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        const FieldArray* sources[SNAPSHOT_FIELD_COUNT] = {&fields.temperature, &fields.density,
+                                                           &fields.velocityX, &fields.velocityY, pressure};
+        job->fieldMask = 0;
+        job->cells = fields.cells();
+        for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+            job->sources[f] = nullptr;
+            if (!sources[f] || sources[f]->count() != fields.cells()) continue;
+            if (job->arrays[f].count() != fields.cells()) job->arrays[f] = FieldArray(fields.cells());
+            if (f == PRESSURE_FIELD) {
+                std::copy_n(sources[f]->data(), fields.cells(), job->arrays[f].data());
+            } else {
+                job->sources[f] = sources[f]->data();
+            }
+            job->fieldMask |= 1u << f;
+        }
+        job->step = step;
+        job->path = path;
+        job->checkpoint = checkpoint;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            copyQueue.push_back(job);
+            ++copiesInFlight;
+        }
+        changed.notify_all();
+        return true;
+    }
+
+    // 等待已提交的场复制完成，之后调用方才能修改这些场
+    void awaitCopies() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return copiesInFlight == 0; });
+    }
+
+    // 等待所有已提交的文件写完
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return pending.empty() && freeSlots.size() == slotStorage.size(); });
+    }
+
+    std::size_t dropped() const { return droppedCount; }
+
+private:
+    struct Job {
+        FieldArray arrays[SNAPSHOT_FIELD_COUNT];
+        const float* sources[SNAPSHOT_FIELD_COUNT] = {}; // 尚待复制线程复制的场
+        std::size_t cells = 0;
+        std::uint32_t fieldMask = 0;
+        std::uint64_t step = 0;
+        std::string path;
+        bool checkpoint = false;
+    };
+
+    int nx, ny;
+    std::uint32_t solver;
+    std::uint32_t codec;
+    std::vector<std::unique_ptr<Job>> slotStorage;
+    std::vector<Job*> freeSlots;
+    std::deque<Job*> copyQueue;
+    std::deque<Job*> pending;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread copier;
+    std::thread worker;
+    bool stopping;
+    std::size_t copiesInFlight; // 已提交但尚未复制完成的任务数
+    std::size_t droppedCount;
+
+    std::vector<float> tile;
+    std::vector<char> shuffled;
+    std::vector<char> compressed;
+
+    void copierLoop() {
+        for (;;) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stopping || !copyQueue.empty(); });
+                if (copyQueue.empty()) return;
+                job = copyQueue.front();
+                copyQueue.pop_front();
+            }
+
+            for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+                if (job->sources[f]) std::copy_n(job->sources[f], job->cells, job->arrays[f].data());
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --copiesInFlight;
+                pending.push_back(job);
+            }
+            changed.notify_all();
+        }
+    }
+
+    void writerLoop() {
+        for (;;) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return !pending.empty() || (stopping && copiesInFlight == 0); });
+                if (pending.empty()) return;
+                job = pending.front();
+                pending.pop_front();
+            }
+
+            try {
+                write(*job);
+            } catch (const std::exception& e) {
+                std::cerr << "Snapshot error: " << e.what() << std::endl;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeSlots.push_back(job);
+            }
+            changed.notify_all();
+        }
+    }
+
+    void write(const Job& job) {
+        const std::string target = job.checkpoint ? job.path + ".tmp" : job.path;
+        std::ofstream file(target, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open " + target);
+
+        const int tileSize = SNAPSHOT_TILE_SIZE;
+        const int tilesX = (nx + tileSize - 1) / tileSize;
+        const int tilesY = (ny + tileSize - 1) / tileSize;
+
+        SnapshotHeader header;
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+        header.version = SNAPSHOT_VERSION;
+        header.nx = nx;
+        header.ny = ny;
+        header.fieldMask = job.fieldMask;
+        header.tileSize = tileSize;
+        header.codec = codec;
+        header.solver = solver;
+        header.step = job.step;
+        header.time = job.step * static_cast<double>(TIME_STEP);
+
+        std::vector<SnapshotChunk> index;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::size_t chunkCount = 0;
+        for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+            if (job.fieldMask & (1u << f)) chunkCount += static_cast<std::size_t>(tilesX) * tilesY;
+        }
+        index.resize(chunkCount);
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(SnapshotChunk));
+        std::uint64_t offset = sizeof(header) + index.size() * sizeof(SnapshotChunk);
+
+        std::size_t chunk = 0;
+        for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+            if (!(job.fieldMask & (1u << f))) continue;
+            const float* field = job.arrays[f].data();
+            for (int ti = 0; ti < tilesY; ++ti) {
+                for (int tj = 0; tj < tilesX; ++tj) {
+                    const int rows = std::min(tileSize, ny - ti * tileSize);
+                    const int cols = std::min(tileSize, nx - tj * tileSize);
+                    tile.resize(static_cast<std::size_t>(rows) * cols);
+                    for (int r = 0; r < rows; ++r) {
+                        std::copy_n(field + static_cast<std::size_t>(ti * tileSize + r) * nx + tj * tileSize, cols,
+                                    tile.data() + static_cast<std::size_t>(r) * cols);
+                    }
+                    const std::uint32_t rawBytes = static_cast<std::uint32_t>(tile.size() * sizeof(float));
+                    const char* data = reinterpret_cast<const char*>(tile.data());
+                    std::uint32_t storedBytes = rawBytes;
+                    if (codec == SNAPSHOT_DEFLATE) {
+                        storedBytes = compressTile();
+                        data = compressed.data();
+                    }
+                    file.write(data, storedBytes);
+                    index[chunk].offset = offset;
+                    index[chunk].storedBytes = storedBytes;
+                    index[chunk].rawBytes = rawBytes;
+                    offset += storedBytes;
+                    ++chunk;
                 }
             }
         }
+
+        file.seekp(sizeof(header));
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(SnapshotChunk));
+        file.close();
+        if (!file) throw std::runtime_error("Failed writing " + target);
+        if (job.checkpoint && std::rename(target.c_str(), job.path.c_str()) != 0) {
+            throw std::runtime_error("Cannot replace checkpoint " + job.path);
+        }
     }
-    return initialGrid;
+
+    std::uint32_t compressTile() {
+#ifdef CFD_WITH_ZLIB
+        const std::size_t cells = tile.size();
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(tile.data());
+        shuffled.resize(cells * sizeof(float));
+        for (int b = 0; b < 4; ++b) {
+            for (std::size_t k = 0; k < cells; ++k) shuffled[b * cells + k] = bytes[4 * k + b];
+        }
+        uLongf length = compressBound(shuffled.size());
+        compressed.resize(length);
+        if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &length,
+                      reinterpret_cast<const Bytef*>(shuffled.data()), shuffled.size(), 1) != Z_OK) {
+            throw std::runtime_error("Snapshot compression failed");
+        }
+        return static_cast<std::uint32_t>(length);
+#else
+        return 0;
+#endif
+    }
+};
+
+// 从检查点恢复全部场与步数
+void loadCheckpoint(const std::string& filename, CFDSimulation& simulation) {
+    SnapshotReader reader(filename);
+    FluidFields& fields = simulation.state();
+    if (reader.width() != fields.nx || reader.height() != fields.ny) {
+        throw std::runtime_error("Checkpoint size does not match the grid");
+    }
+    if (reader.solver() != static_cast<std::uint32_t>(simulation.solverType())) {
+        throw std::runtime_error("Checkpoint was written by a different solver");
+    }
+    FieldArray* targets[SNAPSHOT_FIELD_COUNT] = {&fields.temperature, &fields.density,
+                                                 &fields.velocityX, &fields.velocityY, simulation.pressureField()};
+    for (int f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+        if (targets[f] && reader.hasField(f)) {
+            reader.readRegion(f, 0, 0, fields.ny, fields.nx, targets[f]->data());
+        } else if (f != PRESSURE_FIELD) {
+            throw std::runtime_error(std::string("Checkpoint is missing field ") + SNAPSHOT_FIELD_NAMES[f]);
+        }
+    }
+    simulation.setStepCount(reader.step());
 }
 
+// 把快照中某个场的子区域以 CSV 输出到标准输出
+int extractSnapshot(const std::string& filename, const std::string& fieldName, int i0, int j0, int rows, int cols) {
+    SnapshotReader reader(filename);
+    if (rows <= 0) rows = reader.height() - i0;
+    if (cols <= 0) cols = reader.width() - j0;
+    std::vector<float> region(static_cast<std::size_t>(rows) * cols);
+    reader.readRegion(fieldFromName(fieldName), i0, j0, rows, cols, region.data());
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            std::cout << region[static_cast<std::size_t>(i) * cols + j] << (j + 1 < cols ? "," : "\n");
+        }
+    }
+    return 0;
+}
+
+// 把温度 / 密度映射为 RGBA8 图像（红 = T/100，蓝 = ρ/1000），width x height 不超过网格时按最近邻抽样。
+// 查看器和离线导出共用这一颜色映射。
+void colorizeFields(const FluidFields& fields, int width, int height, std::vector<unsigned char>& rgba, ThreadPool& pool) {
+    rgba.resize(static_cast<std::size_t>(width) * height * 4);
+    pool.parallelFor(0, height, ROW_BLOCK, [&](std::size_t rowBegin, std::size_t rowEnd) {
+        for (std::size_t y = rowBegin; y < rowEnd; ++y) {
+            const int i = static_cast<int>(y * fields.ny / height);
+            const float* temperature = fields.temperature.data() + fields.index(i, 0);
+            const float* density = fields.density.data() + fields.index(i, 0);
+            unsigned char* pixel = rgba.data() + y * width * 4;
+            for (int x = 0; x < width; ++x, pixel += 4) {
+                const int j = static_cast<int>(static_cast<std::size_t>(x) * fields.nx / width);
+                float red = std::min(std::max(temperature[j] / 100.0f, 0.0f), 1.0f);
+                float blue = std::min(std::max(density[j] / 1000.0f, 0.0f), 1.0f);
+                pixel[0] = static_cast<unsigned char>(red * 255.0f + 0.5f);
+                pixel[1] = 0;
+                pixel[2] = static_cast<unsigned char>(blue * 255.0f + 0.5f);
+                pixel[3] = 255;
+            }
+        }
+    });
+}
+
+#ifndef CFD_HEADLESS
+// 可选的 OpenGL 查看器，只读取模拟状态。
+// 默认使用保留模式：整个网格每帧一次性上传到一张纹理，再用 VBO 中的一个四边形绘制；
+// immediate 为 true 时使用旧的逐单元 glBegin/glEnd 路径，便于对比帧时间。
+class CFDViewer {
+public:
+    CFDViewer(const FluidFields& fields, ThreadPool& pool, bool immediate)
+        : pool(pool), immediate(immediate), texture(0), vertexBuffer(0) {
+        if (immediate) return;
+
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        textureWidth = std::min(fields.nx, static_cast<int>(maxTextureSize));
+        textureHeight = std::min(fields.ny, static_cast<int>(maxTextureSize));
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        // 覆盖整个视口的四边形：x, y, s, t
+        const GLfloat quad[] = {
+            -1.0f, -1.0f, 0.0f, 0.0f,
+             1.0f, -1.0f, 1.0f, 0.0f,
+            -1.0f,  1.0f, 0.0f, 1.0f,
+             1.0f,  1.0f, 1.0f, 1.0f,
+        };
+        glGenBuffers(1, &vertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~CFDViewer() {
+        if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+        if (texture) glDeleteTextures(1, &texture);
+    }
+
+    CFDViewer(const CFDViewer&) = delete;
+    CFDViewer& operator=(const CFDViewer&) = delete;
+
+    void render(const CFDSimulation& simulation) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (immediate) {
+            renderImmediate(simulation.state());
+        } else {
+            renderTexture(simulation.state());
+        }
+        glFlush();
+    }
+
+private:
+    ThreadPool& pool;
+    bool immediate;
+    GLuint texture;
+    GLuint vertexBuffer;
+    int textureWidth = 0;
+    int textureHeight = 0;
+    std::vector<unsigned char> pixels; // 每帧复用的上传缓冲区
+
+    void renderTexture(const FluidFields& fields) {
+        colorizeFields(fields, textureWidth, textureHeight, pixels, pool);
+
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), reinterpret_cast<const GLvoid*>(0));
+        glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), reinterpret_cast<const GLvoid*>(2 * sizeof(GLfloat)));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisable(GL_TEXTURE_2D);
+    }
+
+    void renderImmediate(const FluidFields& fields) const {
+        const float cellW = 2.0f / fields.nx;
+        const float cellH = 2.0f / fields.ny;
+
+        for (int i = 0; i < fields.ny; ++i) {
+            for (int j = 0; j < fields.nx; ++j) {
+                float temp = fields.temperature[fields.index(i, j)];
+                float dens = fields.density[fields.index(i, j)];
+
+                // 颜色映射
+                glColor3f(temp / 100.0f, 0.0f, dens / 1000.0f);
+
+                // 绘制矩形
+                float x = -1.0f + j * cellW;
+                float y = -1.0f + i * cellH;
+                glBegin(GL_QUADS);
+                glVertex2f(x, y);
+                glVertex2f(x, y + cellH);
+                glVertex2f(x + cellW, y + cellH);
+                glVertex2f(x + cellW, y);
+                glEnd();
+            }
+        }
+    }
+};
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 }
 
-int main() {
+// 模拟持续推进，渲染按 targetFps 限速，两者互不牵制
+int runViewer(CFDSimulation& simulation, bool immediate, double targetFps) {
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
@@ -128,20 +1944,453 @@ int main() {
     }
     glfwMakeContextCurrent(window);
     glfwSetKeyCallback(window, key_callback);
-    
+    glfwSwapInterval(0);
+
     // 初始化GLEW
     glewInit();
-    
-    std::vector<FluidCell> initialGrid = loadInitialGrid("fusion_data.csv");
-    
-    CFDSimulation simulation(initialGrid);
 
-    while (!glfwWindowShouldClose(window)) {
-        simulation.simulate(TIME_STEPS);
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    {
+        CFDViewer viewer(simulation.state(), simulation.threadPool(), immediate);
+        FrameStats stats(immediate ? "CFD viewer, immediate mode" : "CFD viewer, texture");
+        const double frameInterval = 1.0 / targetFps;
+        double nextFrame = glfwGetTime();
+
+        while (!glfwWindowShouldClose(window)) {
+            simulation.update();
+            stats.addSimulationSteps(1);
+
+            double now = glfwGetTime();
+            if (now < nextFrame) continue;
+            nextFrame = std::max(nextFrame + frameInterval, now);
+
+            stats.beginFrame();
+            viewer.render(simulation);
+            glfwSwapBuffers(window);
+            stats.endFrame();
+            glfwPollEvents();
+        }
     }
 
     glfwTerminate();
     return 0;
 }
+#endif
+
+double checksum(const FluidFields& fields) {
+    double sum = 0.0;
+    for (std::size_t k = 0; k < fields.cells(); ++k) {
+        sum += fields.temperature[k] + fields.density[k] + fields.velocityX[k] + fields.velocityY[k];
+    }
+    return sum;
+}
+
+bool identicalFields(const FluidFields& a, const FluidFields& b) {
+    const std::size_t bytes = a.cells() * sizeof(float);
+    return a.cells() == b.cells() &&
+           std::memcmp(a.temperature.data(), b.temperature.data(), bytes) == 0 &&
+           std::memcmp(a.density.data(), b.density.data(), bytes) == 0 &&
+           std::memcmp(a.velocityX.data(), b.velocityX.data(), bytes) == 0 &&
+           std::memcmp(a.velocityY.data(), b.velocityY.data(), bytes) == 0;
+}
+
+// 扩展性基准：线程数从 1 到 maxThreads，检查结果与单线程逐位一致
+int runScalingBenchmark(int nx, int ny, int steps, unsigned maxThreads, const std::string& input,
+                        SolverType solver, const FluidParameters& parameters, const CFDKernels& kernels) {
+    std::unique_ptr<CFDSimulation> reference;
+    double baseSeconds = 0.0;
+    bool allIdentical = true;
+
+    std::cout << "threads,seconds,Mcell_per_s,speedup,efficiency,identical" << std::endl;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        std::unique_ptr<CFDSimulation> simulation(new CFDSimulation(nx, ny, threads, solver, parameters));
+        simulation->setKernels(kernels);
+        loadInitialGrid(input, simulation->state(), simulation->threadPool());
+
+        auto start = std::chrono::steady_clock::now();
+        simulation->simulate(steps);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool identical = true;
+        if (!reference) {
+            baseSeconds = seconds;
+            reference = std::move(simulation);
+        } else {
+            identical = identicalFields(reference->state(), simulation->state());
+            allIdentical = allIdentical && identical;
+        }
+
+        double speedup = baseSeconds / seconds;
+        std::cout << threads << "," << seconds << ","
+                  << static_cast<double>(nx) * ny * steps / seconds / 1e6 << ","
+                  << speedup << "," << speedup / threads << ","
+                  << (identical ? "yes" : "NO") << std::endl;
+    }
+
+    if (!allIdentical) {
+        std::cerr << "Multithreaded result differs from single-threaded result" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 用随机数据比较各 SIMD 内核与标量参考实现，行长覆盖所有尾部情况。
+// 各内核与参考实现按同样的顺序运算，因此要求逐位一致；部分单元的密度为 0，两边都必须得到 NaN
+int runKernelSelfCheck() {
+    const float TOLERANCE = 0.0f;
+    const int ZERO_DENSITY_EVERY = 7;
+    const int STRIDE = 1040;
+    const int ROWS = 3;
+    std::vector<float> inputs[5];
+    unsigned state = 12345u;
+    for (auto& input : inputs) {
+        input.resize(STRIDE * ROWS);
+        for (float& value : input) {
+            state = state * 1664525u + 1013904223u;
+            value = static_cast<float>(state >> 8) / 16777216.0f; // [0, 1)
+        }
+    }
+    const float* temperature = inputs[0].data();
+    const float* velocityX = inputs[2].data();
+    const float* velocityY = inputs[3].data();
+    const float* p = inputs[4].data();
+    std::vector<float> density(inputs[1]);
+    for (std::size_t k = 0; k < density.size(); ++k) {
+        density[k] = (k % ZERO_DENSITY_EVERY == 0) ? 0.0f : density[k] + 0.5f;
+    }
+
+    // 一边是 NaN 而另一边不是时误差记为无穷大
+    auto relativeError = [](const std::vector<float>& a, const std::vector<float>& b) {
+        double worst = 0.0;
+        for (std::size_t k = 0; k < a.size(); ++k) {
+            if (std::isnan(a[k]) || std::isnan(b[k])) {
+                if (std::isnan(a[k]) != std::isnan(b[k])) worst = std::numeric_limits<double>::infinity();
+                continue;
+            }
+            worst = std::max(worst, std::fabs(static_cast<double>(a[k]) - b[k]) / std::max(1.0, std::fabs(static_cast<double>(b[k]))));
+        }
+        return worst;
+    };
+
+    bool passed = true;
+    for (const CFDKernels* kernel : availableKernels()) {
+        double worst = 0.0;
+        for (int count = 1; count <= STRIDE - 2; count = (count < 40) ? count + 1 : count * 2 + 1) {
+            const int offset = STRIDE + 1; // 第二行的第一个内部单元
+            std::vector<float> expected[4], actual[4];
+            for (int f = 0; f < 4; ++f) {
+                expected[f].assign(STRIDE * ROWS, 0.0f);
+                actual[f].assign(STRIDE * ROWS, 0.0f);
+            }
+
+            SCALAR_KERNELS.reactionRow(temperature + offset, density.data() + offset, velocityX + offset, velocityY + offset,
+                                       expected[0].data() + offset, expected[1].data() + offset,
+                                       expected[2].data() + offset, expected[3].data() + offset, count);
+            kernel->reactionRow(temperature + offset, density.data() + offset, velocityX + offset, velocityY + offset,
+                                actual[0].data() + offset, actual[1].data() + offset,
+                                actual[2].data() + offset, actual[3].data() + offset, count);
+            for (int f = 0; f < 4; ++f) worst = std::max(worst, relativeError(actual[f], expected[f]));
+
+            SCALAR_KERNELS.divergenceRow(velocityX + offset, velocityY + offset, STRIDE, expected[0].data() + offset, count, 0.5f);
+            kernel->divergenceRow(velocityX + offset, velocityY + offset, STRIDE, actual[0].data() + offset, count, 0.5f);
+            worst = std::max(worst, relativeError(actual[0], expected[0]));
+
+            expected[1].assign(velocityX, velocityX + STRIDE * ROWS);
+            expected[2].assign(velocityY, velocityY + STRIDE * ROWS);
+            actual[1] = expected[1];
+            actual[2] = expected[2];
+            SCALAR_KERNELS.subtractGradientRow(p + offset, STRIDE, expected[1].data() + offset, expected[2].data() + offset, count, 0.5f);
+            kernel->subtractGradientRow(p + offset, STRIDE, actual[1].data() + offset, actual[2].data() + offset, count, 0.5f);
+            worst = std::max(worst, std::max(relativeError(actual[1], expected[1]), relativeError(actual[2], expected[2])));
+        }
+
+        bool ok = worst <= TOLERANCE;
+        passed = passed && ok;
+        std::cout << kernel->name << ": max relative error " << worst << (ok ? " (ok)" : " (FAILED)") << std::endl;
+    }
+    return passed ? 0 : -1;
+}
+
+// 多重网格收敛检查：奇偶尺寸、细长网格和各向异性间距下，随机右端项的压力方程与扩散方程都必须收敛
+int runMultigridSelfCheck() {
+    struct Case { int nx, ny; float aspect; } cases[] = {
+        {35, 35, 1.0f}, {36, 36, 1.0f}, {66, 66, 1.0f}, {67, 67, 1.0f}, {515, 300, 1.0f}, {300, 515, 1.0f},
+        {202, 22, 1.0f}, {9, 7, 1.0f}, {130, 131, 4.0f}};
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    bool passed = true;
+    for (const Case& c : cases) {
+        const float h = 1.0f / (std::max(c.nx, c.ny) - 2);
+        MultigridSolver multigrid(c.nx, c.ny, h, h * c.aspect, pool);
+        for (int diffusion = 0; diffusion < 2; ++diffusion) {
+            std::vector<float> x(static_cast<std::size_t>(c.nx) * c.ny, 0.0f), f(x.size(), 0.0f);
+            unsigned state = 12345u;
+            for (int i = 1; i < c.ny - 1; ++i) {
+                for (int j = 1; j < c.nx - 1; ++j) {
+                    state = state * 1664525u + 1013904223u;
+                    f[static_cast<std::size_t>(i) * c.nx + j] = static_cast<float>(state >> 8) / 8388608.0f - 1.0f; // [-1, 1)
+                }
+            }
+            const bool ok = diffusion ? multigrid.solve(x.data(), f.data(), 1.0f / (1e-4f * TIME_STEP), VELOCITY_X_BOUNDARY, false)
+                                      : multigrid.solve(x.data(), f.data(), 0.0f, SCALAR_BOUNDARY, true);
+            passed = passed && ok;
+            std::cout << "multigrid " << c.nx << "x" << c.ny << (c.aspect != 1.0f ? " anisotropic" : "")
+                      << (diffusion ? " diffusion" : " pressure") << ": " << multigrid.levelCount() << " levels, "
+                      << multigrid.lastCycles() << " V-cycles, relative residual " << multigrid.lastResidual()
+                      << (ok ? " (ok)" : " (FAILED)") << std::endl;
+        }
+    }
+    return passed ? 0 : -1;
+}
+
+struct OutputOptions {
+    int snapshotEvery = 0;                 // 每隔多少步写一次快照，0 表示不写
+    std::string snapshotPrefix = "snapshot";
+    int checkpointEvery = 0;               // 每隔多少步覆盖一次检查点，0 表示不写
+    std::string checkpointPath = "checkpoint.cfds";
+    bool compress = false;
+    int frameEvery = 0;                    // 每隔多少步导出一帧图像，0 表示不导出
+    std::string framePrefix = "frame";
+    int frameWidth = 0;                    // 导出图像宽度，0 表示 min(nx, 1024)
+};
+
+std::string snapshotName(const std::string& prefix, std::uint64_t step) {
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%08llu.cfds", static_cast<unsigned long long>(step));
+    return prefix + suffix;
+}
+
+// 无界面批处理模式：推进模拟、按需写快照和检查点，并报告吞吐量
+int runHeadless(CFDSimulation& simulation, int steps, const OutputOptions& output) {
+    const FluidFields& fields = simulation.state();
+    std::unique_ptr<SnapshotWriter> writer;
+    if (output.snapshotEvery > 0 || output.checkpointEvery > 0) {
+        writer.reset(new SnapshotWriter(fields.nx, fields.ny, simulation.solverType(), output.compress));
+    }
+
+    // 离屏导出：CPU 着色后交给编码线程写图像序列，不需要窗口或 GL
+    std::unique_ptr<FrameExporter> exporter;
+    SoftwareFramebuffer frame;
+    std::vector<unsigned char> rgba;
+    if (output.frameEvery > 0) {
+        const int width = output.frameWidth > 0 ? output.frameWidth : std::min(fields.nx, 1024);
+        const int height = std::max(1, static_cast<int>(static_cast<long long>(width) * fields.ny / fields.nx));
+        frame.resize(width, height);
+        exporter.reset(new FrameExporter(output.framePrefix));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) {
+        simulation.update();
+        // update() 只读 state() 的数组、写入另一套缓冲区后交换，上一次提交的场要到下一步才会被覆盖，
+        // 因此复制与这一步并行，只需在再次提交（即下一步之前）时等待
+        if (writer) writer->awaitCopies();
+        const std::uint64_t step = simulation.steps();
+        if (output.snapshotEvery > 0 && step % output.snapshotEvery == 0) {
+            writer->submit(simulation.state(), nullptr, step, snapshotName(output.snapshotPrefix, step), false);
+        }
+        if (output.checkpointEvery > 0 && step % output.checkpointEvery == 0) {
+            writer->submit(simulation.state(), simulation.pressureField(), step, output.checkpointPath, true);
+        }
+        if (exporter && step % output.frameEvery == 0) {
+            colorizeFields(simulation.state(), frame.getWidth(), frame.getHeight(), rgba, simulation.threadPool());
+            frame.blitRGBA(rgba.data(), frame.getWidth(), frame.getHeight());
+            exporter->submit(frame);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (writer) {
+        writer->flush();
+        if (writer->dropped() > 0) {
+            std::cerr << writer->dropped() << " snapshots dropped because the writer fell behind" << std::endl;
+        }
+    }
+    if (exporter) {
+        exporter->finish();
+        std::cout << exporter->framesSubmitted() << " frames written to " << output.framePrefix << "_*.ppm" << std::endl;
+    }
+
+    double meanTemperature = 0.0;
+    for (std::size_t k = 0; k < fields.cells(); ++k) {
+        meanTemperature += fields.temperature[k];
+    }
+    meanTemperature /= fields.cells();
+
+    std::cout << "Grid " << fields.nx << "x" << fields.ny << ", " << simulation.threads() << " threads, "
+              << simulation.activeKernels().name << " kernels, "
+              << steps << " steps in "
+              << seconds << " s (" << (static_cast<double>(fields.cells()) * steps / seconds / 1e6)
+              << " Mcell/s), mean temperature " << meanTemperature
+              << ", checksum " << checksum(fields) << std::endl;
+    if (const MultigridSolver* multigrid = simulation.pressureSolver()) {
+        std::cout << "Multigrid: " << multigrid->levelCount() << " levels, last solve "
+                  << multigrid->lastCycles() << " V-cycles, relative residual "
+                  << multigrid->lastResidual() << std::endl;
+        if (simulation.unconvergedSolves() > 0) {
+            std::cerr << "Warning: " << simulation.unconvergedSolves() << " multigrid solves did not converge" << std::endl;
+        }
+    }
+    return 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--headless] [--size NX NY] [--steps N] [--threads N] [--bench] [--input FILE]\n"
+              << "       (the input file must exist; it defaults to fusion_data.csv)\n"
+              << "       [--solver simple|stable] [--viscosity NU] [--diffusivity K] [--buoyancy B]\n"
+              << "       [--isa scalar|sse4.2|avx2|avx512] [--selfcheck]\n"
+              << "       [--write-initial FILE]   convert the input to the binary field format and exit\n"
+              << "       [--snapshot-every N] [--snapshot-prefix P] [--checkpoint-every N] [--checkpoint FILE]\n"
+              << "       [--compress] [--restart CHECKPOINT]\n"
+              << "       [--frames-every N] [--frames-prefix P] [--frames-width W]   export PPM frames (headless)\n"
+              << "       [--fps N] [--immediate]   viewer frame-rate cap and legacy immediate-mode rendering\n"
+              << "       --extract SNAPSHOT FIELD [I0 J0 ROWS COLS]   print a field region as CSV and exit" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int nx = GRID_SIZE;
+    int ny = GRID_SIZE;
+    int steps = TIME_STEPS;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool bench = false;
+    bool sizeGiven = false;
+    SolverType solver = SolverType::Simplified;
+    FluidParameters parameters;
+    std::string isa;
+    std::string output;
+    std::string restart;
+    OutputOptions outputOptions;
+    double targetFps = 60.0;
+    bool immediate = false;
+    std::string input = "fusion_data.csv";
+#ifdef CFD_HEADLESS
+    bool headless = true;
+#else
+    bool headless = false;
+#endif
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--size" && a + 2 < argc) {
+            nx = std::atoi(argv[++a]);
+            ny = std::atoi(argv[++a]);
+            sizeGiven = true;
+        } else if (arg == "--steps" && a + 1 < argc) {
+            steps = std::atoi(argv[++a]);
+        } else if (arg == "--threads" && a + 1 < argc) {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++a])));
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--solver" && a + 1 < argc) {
+            std::string name = argv[++a];
+            if (name == "stable") {
+                solver = SolverType::StableFluids;
+            } else if (name != "simple") {
+                printUsage(argv[0]);
+                return -1;
+            }
+        } else if (arg == "--viscosity" && a + 1 < argc) {
+            parameters.viscosity = std::strtof(argv[++a], nullptr);
+        } else if (arg == "--diffusivity" && a + 1 < argc) {
+            parameters.diffusivity = std::strtof(argv[++a], nullptr);
+        } else if (arg == "--buoyancy" && a + 1 < argc) {
+            parameters.buoyancy = std::strtof(argv[++a], nullptr);
+        } else if (arg == "--isa" && a + 1 < argc) {
+            isa = argv[++a];
+        } else if (arg == "--selfcheck") {
+            const int kernelResult = runKernelSelfCheck();
+            const int multigridResult = runMultigridSelfCheck();
+            return (kernelResult == 0 && multigridResult == 0) ? 0 : -1;
+        } else if (arg == "--write-initial" && a + 1 < argc) {
+            output = argv[++a];
+        } else if (arg == "--snapshot-every" && a + 1 < argc) {
+            outputOptions.snapshotEvery = std::atoi(argv[++a]);
+        } else if (arg == "--snapshot-prefix" && a + 1 < argc) {
+            outputOptions.snapshotPrefix = argv[++a];
+        } else if (arg == "--checkpoint-every" && a + 1 < argc) {
+            outputOptions.checkpointEvery = std::atoi(argv[++a]);
+        } else if (arg == "--checkpoint" && a + 1 < argc) {
+            outputOptions.checkpointPath = argv[++a];
+        } else if (arg == "--compress") {
+            outputOptions.compress = true;
+        } else if (arg == "--restart" && a + 1 < argc) {
+            restart = argv[++a];
+        } else if (arg == "--extract" && a + 2 < argc) {
+            try {
+                std::string file = argv[a + 1];
+                std::string field = argv[a + 2];
+                int region[4] = {0, 0, 0, 0};
+                for (int r = 0; r < 4 && a + 3 + r < argc; ++r) region[r] = std::atoi(argv[a + 3 + r]);
+                return extractSnapshot(file, field, region[0], region[1], region[2], region[3]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return -1;
+            }
+        } else if (arg == "--frames-every" && a + 1 < argc) {
+            outputOptions.frameEvery = std::atoi(argv[++a]);
+        } else if (arg == "--frames-prefix" && a + 1 < argc) {
+            outputOptions.framePrefix = argv[++a];
+        } else if (arg == "--frames-width" && a + 1 < argc) {
+            outputOptions.frameWidth = std::atoi(argv[++a]);
+        } else if (arg == "--fps" && a + 1 < argc) {
+            targetFps = std::max(1.0, std::atof(argv[++a]));
+        } else if (arg == "--immediate") {
+            immediate = true;
+        } else if (arg == "--input" && a + 1 < argc) {
+            input = argv[++a];
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+#ifdef CFD_HEADLESS
+    (void)targetFps;
+    (void)immediate;
+#endif
+
+    try {
+        int fileNx = 0, fileNy = 0;
+        if (!restart.empty()) {
+            SnapshotReader reader(restart);
+            fileNx = reader.width();
+            fileNy = reader.height();
+        }
+        if (!restart.empty() || probeFieldFile(input, fileNx, fileNy)) {
+            if (sizeGiven && (fileNx != nx || fileNy != ny)) {
+                throw std::runtime_error("--size does not match the input file");
+            }
+            nx = fileNx;
+            ny = fileNy;
+            sizeGiven = true;
+        }
+
+        if (bench) {
+            if (!sizeGiven) nx = ny = BENCH_GRID_SIZE;
+            return runScalingBenchmark(nx, ny, steps, threads, input, solver, parameters, selectKernels(isa));
+        }
+
+        CFDSimulation simulation(nx, ny, threads, solver, parameters);
+        simulation.setKernels(selectKernels(isa));
+        if (restart.empty()) {
+            loadInitialGrid(input, simulation.state(), simulation.threadPool());
+        } else {
+            loadCheckpoint(restart, simulation);
+        }
+        if (!output.empty()) {
+            saveFieldFile(output, simulation.state());
+            std::cout << "Initial condition written to " << output << std::endl;
+            return 0;
+        }
+
+        if (headless) {
+            return runHeadless(simulation, steps, outputOptions);
+        }
+#ifndef CFD_HEADLESS
+        return runViewer(simulation, immediate, targetFps);
+#endif
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -1,20 +1,30 @@
 #include <iostream>
+// Define CARBON_FUSION_HEADLESS to build without OpenGL/GLFW; only the offscreen export remains
+#ifndef CARBON_FUSION_HEADLESS
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#endif
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <thread>
+#include <string>
+#include <algorithm>
+#include "OffscreenExport.h"
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
+const int ITERATIONS = 100;
 
 class CarbonFusion {
 public:
     CarbonFusion(float temperature, float density)
         : temperature(temperature), density(density) {}
 
+    float getTemperature() const { return temperature; }
+    float getDensity() const { return density; }
+
     bool isFusionPossible() const {
         return (temperature >= 6e8) && (density >= 2e8);
     }
@@ -54,7 +64,76 @@ std::vector<CarbonFusion> loadFusionData(const std::string& filename) {
     return fusionData;
 }
 
-int main() {
+// Offscreen plot: temperature on x, density on y, fusion threshold as grey lines.
+// A blue sweep line moves along the temperature axis; points it has passed are drawn
+// green where carbon fusion is possible and red elsewhere, points ahead of it stay dim
+void renderFusionData(const std::vector<CarbonFusion>& fusionData, float progress, SoftwareFramebuffer& frame) {
+    const int margin = 40;
+    const int plotW = frame.getWidth() - 2 * margin;
+    const int plotH = frame.getHeight() - 2 * margin;
+    float maxTemperature = 6e8f, maxDensity = 2e8f;
+    for (const auto& fusion : fusionData) {
+        maxTemperature = std::max(maxTemperature, fusion.getTemperature());
+        maxDensity = std::max(maxDensity, fusion.getDensity());
+    }
+    maxTemperature *= 1.1f;
+    maxDensity *= 1.1f;
+
+    frame.clear(0.0f, 0.0f, 0.0f);
+    frame.drawLine(margin, margin, margin + plotW, margin, 0.6f, 0.6f, 0.6f);
+    frame.drawLine(margin, margin, margin, margin + plotH, 0.6f, 0.6f, 0.6f);
+    const int thresholdX = margin + static_cast<int>(6e8f / maxTemperature * plotW);
+    const int thresholdY = margin + static_cast<int>(2e8f / maxDensity * plotH);
+    frame.drawLine(thresholdX, margin, thresholdX, margin + plotH, 0.3f, 0.3f, 0.3f);
+    frame.drawLine(margin, thresholdY, margin + plotW, thresholdY, 0.3f, 0.3f, 0.3f);
+    const float sweepTemperature = progress * maxTemperature;
+    const int sweepX = margin + static_cast<int>(progress * plotW);
+    frame.drawLine(sweepX, margin, sweepX, margin + plotH, 0.2f, 0.4f, 1.0f);
+
+    for (const auto& fusion : fusionData) {
+        const float x = margin + fusion.getTemperature() / maxTemperature * plotW;
+        const float y = margin + fusion.getDensity() / maxDensity * plotH;
+        if (fusion.getTemperature() > sweepTemperature) {
+            frame.drawPoint(x, y, 5, 0.4f, 0.4f, 0.4f);
+        } else if (fusion.isFusionPossible()) {
+            frame.drawPoint(x, y, 7, 0.2f, 1.0f, 0.2f);
+        } else {
+            frame.drawPoint(x, y, 7, 1.0f, 0.2f, 0.2f);
+        }
+    }
+}
+
+// Offscreen mode: no window, one frame per iteration encoded on a background thread
+int runOffscreen(const std::vector<CarbonFusion>& fusionData, const std::string& prefix) {
+    SoftwareFramebuffer frame(WIDTH, HEIGHT);
+    FrameExporter exporter(prefix);
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+        std::cout << "Iteration: " << iteration + 1 << std::endl;
+        for (const auto& fusion : fusionData) {
+            fusion.simulate();
+        }
+        renderFusionData(fusionData, static_cast<float>(iteration + 1) / ITERATIONS, frame);
+        exporter.submit(frame);
+    }
+    exporter.finish();
+    std::cout << exporter.framesSubmitted() << " frames written to " << prefix << "_*.ppm" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--offscreen") {
+        try {
+            return runOffscreen(loadFusionData("fusion_data.csv"), argc > 2 ? argv[2] : "carbon_fusion");
+        } catch (const std::exception& e) {
+            std::cerr << "Offscreen export failed: " << e.what() << std::endl;
+            return -1;
+        }
+    }
+
+#ifdef CARBON_FUSION_HEADLESS
+    std::cerr << "Usage: " << argv[0] << " --offscreen [PREFIX]" << std::endl;
+    return -1;
+#else
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -77,7 +156,7 @@ int main() {
     std::vector<CarbonFusion> fusionData = loadFusionData("fusion_data.csv");
     
     // Iterate over data for 100 iterations
-    for (int iteration = 0; iteration < 100; ++iteration) {
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
         std::cout << "Iteration: " << iteration + 1 << std::endl;
         for (const auto& fusion : fusionData) {
             fusion.simulate();
@@ -99,4 +178,5 @@ int main() {
 
     glfwTerminate();
     return 0;
+#endif
 }
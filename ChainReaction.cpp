@@ -4,29 +4,335 @@
 #include <vector>
 #include <string>
 #include <cmath> // 引入cmath头文件以使用指数和其他数学函数
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include "TimeSeriesSink.h"
+#include "ThreadPool.h"
+#include "Philox.h"
 
+// 日志先写入带缓冲的文件，由调用线程同步写出，不再逐行刷新
 class ChainReactionLogger {
 private:
-    std::ofstream logFile;
+    TimeSeriesSink logFile;
 
+    static SinkOptions appendOptions() {
+        SinkOptions options;
+        options.append = true;
+        options.threaded = false; // 日志在模拟结束后一次写出，直接写入带缓冲的文件即可
+        return options;
+    }
+
+public:
+    ChainReactionLogger(const std::string& filename) : logFile(filename, {}, appendOptions()) {}
+
+    void log(const std::string& message) {
+        logFile.appendLine(message);
+    }
+
+    void log(const char* message, std::size_t length) {
+        logFile.appendLine(message, length);
+    }
+};
+
+// 模拟结果：按 (t, N, I) 连续存放的原始数值，容量在模拟开始前预留
+class ReactionTrace {
+public:
+    void clear() { values.clear(); }
+    void reserve(std::size_t samples) { values.reserve(samples * FIELDS); }
+
+    void push(double t, double N, double I) {
+        values.push_back(t);
+        values.push_back(N);
+        values.push_back(I);
+    }
+
+    std::size_t size() const { return values.size() / FIELDS; }
+    const double* sample(std::size_t k) const { return &values[k * FIELDS]; }
+
+private:
+    static const std::size_t FIELDS = 3;
+    std::vector<double> values;
+};
+
+// 连续时间的反应动力学方程组，状态 y = (N, I)，速率均按单位时间计：
+// dN/dt = -λ(T) N I
+// dI/dt = ν λ(T) N I - β(T) I - a I + D N / (N + I)
+struct ReactionRates {
+    double nu;
+    double fission;    // 温度修正后的裂变截面 λ(T)
+    double leak;       // 温度修正后的漏失率 β(T)
+    double absorption;
+    double diffusion;
+
+    void derivatives(const double y[2], double dydt[2]) const {
+        const double N = std::max(y[0], 0.0);
+        const double I = std::max(y[1], 0.0);
+        const double fissionRate = fission * N * I;
+        const double total = N + I;
+        dydt[0] = -fissionRate;
+        dydt[1] = nu * fissionRate - (leak + absorption) * I + (total > 0 ? diffusion * N / total : 0.0);
+    }
+
+    // 雅可比矩阵 J[i][j] = ∂f_i / ∂y_j
+    void jacobian(const double y[2], double J[2][2]) const {
+        const double N = std::max(y[0], 0.0);
+        const double I = std::max(y[1], 0.0);
+        const double total = N + I;
+        const double inverseSquare = total > 0 ? 1.0 / (total * total) : 0.0;
+        J[0][0] = -fission * I;
+        J[0][1] = -fission * N;
+        J[1][0] = nu * fission * I + diffusion * I * inverseSquare;
+        J[1][1] = nu * fission * N - leak - absorption - diffusion * N * inverseSquare;
+    }
+};
+
+// 积分器选项。固定步长方法只使用 step；自适应方法把 step 作为初始步长，
+// 并按 relativeTolerance / absoluteTolerance 控制每步的局部误差
+struct IntegratorOptions {
+    double relativeTolerance = 1e-6;
+    double absoluteTolerance = 1e-9;
+    double step = 1e-3;
+    double minStep = 1e-12;
+    double maxStep = std::numeric_limits<double>::infinity();
+    unsigned long maxSteps = 100000000;
+};
+
+struct IntegrationStats {
+    unsigned long steps = 0;      // 接受的步数
+    unsigned long rejected = 0;   // 被拒绝的步数
+    unsigned long evaluations = 0; // 右端函数求值次数
+    unsigned long jacobians = 0;  // 雅可比矩阵求值次数
+};
+
+// 积分器接口：从 t 积分到 tEnd，y 原地更新；每个接受的步之后调用 observer(t, y)
+class ReactionIntegrator {
 public:
-    ChainReactionLogger(const std::string& filename) : logFile(filename, std::ios::app) {
-        if (!logFile) {
-            throw std::runtime_error("无法打开日志文件");
+    typedef std::function<void(double, const double*)> Observer;
+
+    explicit ReactionIntegrator(const IntegratorOptions& options) : options(options) {}
+    virtual ~ReactionIntegrator() {}
+
+    virtual const char* name() const = 0;
+    virtual IntegrationStats integrate(const ReactionRates& rates, double t, double tEnd, double y[2],
+                                       const Observer& observer) = 0;
+
+    const IntegratorOptions& getOptions() const { return options; }
+
+protected:
+    IntegratorOptions options;
+
+    // 加权均方根误差范数，误差为 1 时恰好达到容差
+    double errorNorm(const double y[2], const double yNew[2], const double error[2]) const {
+        double sum = 0.0;
+        for (int i = 0; i < 2; ++i) {
+            const double scale = options.absoluteTolerance +
+                                 options.relativeTolerance * std::max(std::fabs(y[i]), std::fabs(yNew[i]));
+            sum += (error[i] / scale) * (error[i] / scale);
+        }
+        return std::sqrt(sum / 2);
+    }
+
+    // 按误差调整步长：order 为误差估计的阶数加一
+    double nextStep(double h, double error, double order, bool rejected) const {
+        double factor = error > 0 ? 0.9 * std::pow(error, -1.0 / order) : 5.0;
+        factor = std::min(std::max(factor, 0.2), rejected ? 1.0 : 5.0);
+        return std::min(std::max(h * factor, options.minStep), options.maxStep);
+    }
+
+    static void clampState(double y[2]) {
+        if (y[0] < 0) y[0] = 0; // 限制原子数量不为负数
+        if (y[1] < 0) y[1] = 0; // 防止中子数量为负数
+    }
+};
+
+// 固定步长显式 Euler：增量按步长缩放，稳定性要求 h 小于最快时间尺度
+class ExplicitEulerIntegrator : public ReactionIntegrator {
+public:
+    explicit ExplicitEulerIntegrator(const IntegratorOptions& options) : ReactionIntegrator(options) {}
+
+    const char* name() const { return "euler"; }
+
+    IntegrationStats integrate(const ReactionRates& rates, double t, double tEnd, double y[2], const Observer& observer) {
+        IntegrationStats stats;
+        double dydt[2];
+        while (t < tEnd && stats.steps < options.maxSteps) {
+            const double h = std::min(options.step, tEnd - t);
+            rates.derivatives(y, dydt);
+            ++stats.evaluations;
+            y[0] += h * dydt[0];
+            y[1] += h * dydt[1];
+            clampState(y);
+            t += h;
+            ++stats.steps;
+            if (observer) observer(t, y);
         }
+        return stats;
     }
+};
+
+// Dormand–Prince 5(4) 嵌入式 Runge–Kutta，自适应步长；末级导数复用为下一步的首级（FSAL）
+class DormandPrinceIntegrator : public ReactionIntegrator {
+public:
+    explicit DormandPrinceIntegrator(const IntegratorOptions& options) : ReactionIntegrator(options) {}
+
+    const char* name() const { return "rk45"; }
+
+    IntegrationStats integrate(const ReactionRates& rates, double t, double tEnd, double y[2], const Observer& observer) {
+        static const double A21 = 1.0 / 5;
+        static const double A31 = 3.0 / 40, A32 = 9.0 / 40;
+        static const double A41 = 44.0 / 45, A42 = -56.0 / 15, A43 = 32.0 / 9;
+        static const double A51 = 19372.0 / 6561, A52 = -25360.0 / 2187, A53 = 64448.0 / 6561, A54 = -212.0 / 729;
+        static const double A61 = 9017.0 / 3168, A62 = -355.0 / 33, A63 = 46732.0 / 5247, A64 = 49.0 / 176,
+                            A65 = -5103.0 / 18656;
+        static const double B1 = 35.0 / 384, B3 = 500.0 / 1113, B4 = 125.0 / 192, B5 = -2187.0 / 6784, B6 = 11.0 / 84;
+        static const double E1 = 71.0 / 57600, E3 = -71.0 / 16695, E4 = 71.0 / 1920, E5 = -17253.0 / 339200,
+                            E6 = 22.0 / 525, E7 = -1.0 / 40;
 
-    ~ChainReactionLogger() {
-        if (logFile.is_open()) {
-            logFile.close();
+        IntegrationStats stats;
+        double k1[2], k2[2], k3[2], k4[2], k5[2], k6[2], k7[2], stage[2], yNew[2], error[2];
+        double h = std::min(options.step, options.maxStep);
+        bool rejected = false;
+        rates.derivatives(y, k1);
+        ++stats.evaluations;
+
+        while (t < tEnd && stats.steps < options.maxSteps) {
+            h = std::min(h, tEnd - t);
+            for (int i = 0; i < 2; ++i) stage[i] = y[i] + h * A21 * k1[i];
+            rates.derivatives(stage, k2);
+            for (int i = 0; i < 2; ++i) stage[i] = y[i] + h * (A31 * k1[i] + A32 * k2[i]);
+            rates.derivatives(stage, k3);
+            for (int i = 0; i < 2; ++i) stage[i] = y[i] + h * (A41 * k1[i] + A42 * k2[i] + A43 * k3[i]);
+            rates.derivatives(stage, k4);
+            for (int i = 0; i < 2; ++i) stage[i] = y[i] + h * (A51 * k1[i] + A52 * k2[i] + A53 * k3[i] + A54 * k4[i]);
+            rates.derivatives(stage, k5);
+            for (int i = 0; i < 2; ++i) {
+                stage[i] = y[i] + h * (A61 * k1[i] + A62 * k2[i] + A63 * k3[i] + A64 * k4[i] + A65 * k5[i]);
+            }
+            rates.derivatives(stage, k6);
+            for (int i = 0; i < 2; ++i) {
+                yNew[i] = y[i] + h * (B1 * k1[i] + B3 * k3[i] + B4 * k4[i] + B5 * k5[i] + B6 * k6[i]);
+            }
+            rates.derivatives(yNew, k7);
+            stats.evaluations += 6;
+            for (int i = 0; i < 2; ++i) {
+                error[i] = h * (E1 * k1[i] + E3 * k3[i] + E4 * k4[i] + E5 * k5[i] + E6 * k6[i] + E7 * k7[i]);
+            }
+
+            const double norm = errorNorm(y, yNew, error);
+            if (norm <= 1.0 || h <= options.minStep) {
+                t += h;
+                y[0] = yNew[0];
+                y[1] = yNew[1];
+                k1[0] = k7[0];
+                k1[1] = k7[1];
+                if (y[0] < 0 || y[1] < 0) {
+                    clampState(y);
+                    rates.derivatives(y, k1);
+                    ++stats.evaluations;
+                }
+                ++stats.steps;
+                if (observer) observer(t, y);
+                h = nextStep(h, norm, 5.0, rejected);
+                rejected = false;
+            } else {
+                ++stats.rejected;
+                h = nextStep(h, norm, 5.0, true);
+                rejected = true;
+            }
         }
+        return stats;
     }
+};
 
-    void log(const std::string& message) {
-        logFile << message << std::endl;
+// 线性隐式 Rosenbrock 2(3) 方法（Shampine & Reichelt, "The MATLAB ODE Suite", ode23s）。
+// 每步只需解两次 2×2 线性方程组 (I - h d J) k = r，L 稳定，适合裂变项主导的刚性阶段
+class RosenbrockIntegrator : public ReactionIntegrator {
+public:
+    explicit RosenbrockIntegrator(const IntegratorOptions& options) : ReactionIntegrator(options) {}
+
+    const char* name() const { return "rosenbrock"; }
+
+    IntegrationStats integrate(const ReactionRates& rates, double t, double tEnd, double y[2], const Observer& observer) {
+        static const double D = 1.0 / (2.0 + std::sqrt(2.0));
+        static const double E32 = 6.0 + std::sqrt(2.0);
+
+        IntegrationStats stats;
+        double f0[2], f1[2], f2[2], k1[2], k2[2], k3[2], stage[2], yNew[2], error[2], rhs[2], J[2][2];
+        double h = std::min(options.step, options.maxStep);
+        bool rejected = false;
+        rates.derivatives(y, f0);
+        ++stats.evaluations;
+
+        while (t < tEnd && stats.steps < options.maxSteps) {
+            h = std::min(h, tEnd - t);
+            rates.jacobian(y, J);
+            ++stats.jacobians;
+
+            // W = I - h d J，按 Cramer 法则求逆
+            const double w00 = 1.0 - h * D * J[0][0], w01 = -h * D * J[0][1];
+            const double w10 = -h * D * J[1][0], w11 = 1.0 - h * D * J[1][1];
+            const double inverseDeterminant = 1.0 / (w00 * w11 - w01 * w10);
+            auto solve = [&](const double r[2], double k[2]) {
+                k[0] = (w11 * r[0] - w01 * r[1]) * inverseDeterminant;
+                k[1] = (w00 * r[1] - w10 * r[0]) * inverseDeterminant;
+            };
+
+            solve(f0, k1);
+            for (int i = 0; i < 2; ++i) stage[i] = y[i] + 0.5 * h * k1[i];
+            rates.derivatives(stage, f1);
+            for (int i = 0; i < 2; ++i) rhs[i] = f1[i] - k1[i];
+            solve(rhs, k2);
+            for (int i = 0; i < 2; ++i) {
+                k2[i] += k1[i];
+                yNew[i] = y[i] + h * k2[i];
+            }
+            rates.derivatives(yNew, f2);
+            for (int i = 0; i < 2; ++i) rhs[i] = f2[i] - E32 * (k2[i] - f1[i]) - 2.0 * (k1[i] - f0[i]);
+            solve(rhs, k3);
+            stats.evaluations += 2;
+            for (int i = 0; i < 2; ++i) error[i] = h / 6.0 * (k1[i] - 2.0 * k2[i] + k3[i]);
+
+            const double norm = errorNorm(y, yNew, error);
+            if (norm <= 1.0 || h <= options.minStep) {
+                t += h;
+                y[0] = yNew[0];
+                y[1] = yNew[1];
+                f0[0] = f2[0];
+                f0[1] = f2[1];
+                if (y[0] < 0 || y[1] < 0) {
+                    clampState(y);
+                    rates.derivatives(y, f0);
+                    ++stats.evaluations;
+                }
+                ++stats.steps;
+                if (observer) observer(t, y);
+                h = nextStep(h, norm, 3.0, rejected);
+                rejected = false;
+            } else {
+                ++stats.rejected;
+                h = nextStep(h, norm, 3.0, true);
+                rejected = true;
+            }
+        }
+        return stats;
     }
 };
 
+// 按名称创建积分器："euler"、"rk45" 或 "rosenbrock"
+std::unique_ptr<ReactionIntegrator> makeIntegrator(const std::string& name, const IntegratorOptions& options) {
+    if (name == "euler") return std::unique_ptr<ReactionIntegrator>(new ExplicitEulerIntegrator(options));
+    if (name == "rk45") return std::unique_ptr<ReactionIntegrator>(new DormandPrinceIntegrator(options));
+    if (name == "rosenbrock") return std::unique_ptr<ReactionIntegrator>(new RosenbrockIntegrator(options));
+    throw std::invalid_argument("未知的积分器: " + name);
+}
+
 class ChainReaction {
 private:
     double nu;          // 每次裂变生成的中子数量
@@ -41,11 +347,11 @@ private:
     ChainReactionLogger logger;
 
     // 温度对裂变率和漏失率的影响函数
-    double calculateFissionRate(double base_rate) {
+    static double calculateFissionRate(double base_rate, double temperature) {
         return base_rate * (1.0 + 0.01 * (temperature - 300.0)); // 假设在300K时为基准
     }
 
-    double calculateLeakRate(double base_rate) {
+    static double calculateLeakRate(double base_rate, double temperature) {
         return base_rate * (1.0 + 0.005 * (temperature - 300.0)); // 假设在300K时为基准
     }
 
@@ -62,15 +368,50 @@ public:
         }
     }
 
+    // 温度修正后的连续时间速率
+    ReactionRates rates() {
+        return ratesFor(nu, lambda, beta, diffusion, absorption, temperature);
+    }
+
+    // 不经构造（也不打开日志文件）直接由物理参数得到速率，供参数扫描使用
+    static ReactionRates ratesFor(double nu, double lambda, double beta, double diffusion, double absorption,
+                                  double temperature) {
+        ReactionRates r;
+        r.nu = nu;
+        r.fission = calculateFissionRate(lambda, temperature);
+        r.leak = calculateLeakRate(beta, temperature);
+        r.absorption = absorption;
+        r.diffusion = diffusion;
+        return r;
+    }
+
+    double initialAtoms() const { return mass * density; } // 初始原子数
+    double diffusionCoefficient() const { return diffusion; }
+
+    // 用给定积分器求解连续时间方程组到 endTime，输出与逐步模拟相同的日志与 CSV（每个接受的步一行）
+    IntegrationStats simulate(double endTime, ReactionIntegrator& integrator) {
+        double y[2] = {initialAtoms(), 1.0}; // 初始原子数与中子数量
+        trace.clear();
+        trace.reserve(static_cast<std::size_t>(std::min(endTime / integrator.getOptions().step, 1e6)) + 2);
+        IntegrationStats stats = integrator.integrate(rates(), 0.0, endTime, y, [this](double t, const double* state) {
+            trace.push(t, state[0], state[1]);
+        });
+        writeOutputs();
+        return stats;
+    }
+
+    // 原始的逐步迭代：每步的增量不随 deltaTime 缩放，deltaTime 只决定迭代次数。
+    // 结果按步数预先分配，循环内只记录 (t, N, I) 三个数，日志与 CSV 在循环结束后统一输出
     void simulate(double endTime, double deltaTime) {
         double N = mass * density;    // 初始原子数
         double I = 1.0;                // 初始中子数量
+        const double currentLambda = calculateFissionRate(lambda, temperature);
+        const double currentBeta = calculateLeakRate(beta, temperature);
 
-        std::vector<std::pair<double, double>> results;
+        trace.clear();
+        trace.reserve(deltaTime > 0 ? static_cast<std::size_t>(endTime / deltaTime) + 2 : 0);
 
         for (double t = 0; t < endTime; t += deltaTime) {
-            double currentLambda = calculateFissionRate(lambda);
-            double currentBeta = calculateLeakRate(beta);
             double fissionRate = currentLambda * N * I; // 裂变率
 
             // 限制裂变不会超过当前原子数
@@ -89,26 +430,882 @@ public:
             if (N < 0) N = 0;
 
             // 存储数据
-            results.emplace_back(t, N);
-            logger.log("时间: " + std::to_string(t) + ", 原子核数量: " + std::to_string(N) + ", 中子数量: " + std::to_string(I));
+            trace.push(t, N, I);
+        }
+
+        writeOutputs();
+    }
+
+    const ReactionTrace& results() const { return trace; }
+
+private:
+    ReactionTrace trace; // 跨多次模拟复用
+
+    // 日志每行格式化到栈上的缓冲区（与 std::to_string 同为 %f），CSV 的数值由输出线程格式化
+    void writeOutputs() {
+        SinkOptions options;
+        options.bufferBytes = std::min<std::size_t>(trace.size() * 3 * sizeof(double), options.bufferBytes);
+        TimeSeriesSink csv("reaction_data.csv", {"时间(s)", "原子核数量", "中子数量"}, options);
+        char line[160];
+        for (std::size_t k = 0; k < trace.size(); ++k) {
+            const double* sample = trace.sample(k);
+            csv.append(sample);
+            const int length = std::snprintf(line, sizeof(line), "时间: %f, 原子核数量: %f, 中子数量: %f",
+                                             sample[0], sample[1], sample[2]);
+            logger.log(line, static_cast<std::size_t>(std::min<int>(length, sizeof(line) - 1)));
+        }
+        csv.close();
+    }
+};
+
+// 蒙特卡罗中子输运的几何：无限平板（只在 x 方向有界）或球
+enum class TransportGeometry { Slab, Sphere };
+
+struct TransportOptions {
+    TransportGeometry geometry = TransportGeometry::Sphere;
+    std::size_t particles = 10000;  // 每代源中子数
+    int generations = 25;           // 总代数
+    int inactive = 5;               // 不计入 k 统计的前几代（源分布收敛）
+    std::size_t batchSize = 4096;   // 每个并行任务处理的中子数
+    std::uint64_t seed = 20240601;
+    unsigned threads = std::thread::hardware_concurrency();
+};
+
+// 一批中子的计数；每批各用一份，按批次顺序归约，结果与线程数无关
+struct TransportTally {
+    double histories = 0;
+    double collisions = 0;
+    double scatters = 0;
+    double absorptions = 0;
+    double fissions = 0;
+    double leaks = 0;
+
+    void add(const TransportTally& other) {
+        histories += other.histories;
+        collisions += other.collisions;
+        scatters += other.scatters;
+        absorptions += other.absorptions;
+        fissions += other.fissions;
+        leaks += other.leaks;
+    }
+};
+
+struct GenerationResult {
+    int generation;
+    double k;          // 本代增殖系数（吸收估计：ν × 裂变次数 / 源中子数）
+    TransportTally tally;
+    std::size_t sites; // 本代产生的裂变源点数
+};
+
+// 基于事件的蒙特卡罗中子输运（k 本征值幂迭代），与点堆模型共用 ν、λ、β、吸收率与扩散系数：
+// 裂变截面 Σf = λ(T)，俘获截面 Σc = 吸收率，总截面由扩散系数给出 Σt = 1 / (3D)，其余为各向同性散射；
+// 几何尺寸取扩散理论中漏失率 β(T) = D B² 对应的曲率，平板厚度与球半径均为 π / B（不计外推距离）。
+// 每代把源中子分成固定大小的批次并行处理；批内中子以结构数组存放，按事件类型分批推进：
+// 飞行（抽样飞行距离并判断碰撞或泄漏）、碰撞（散射或吸收）、吸收（裂变或俘获）。
+// 随机数由 Philox(seed, (代, 事件序号), 中子编号) 给出，每批独立计数、产生的裂变源点按批次顺序拼接，
+// 整个计算与线程数无关。
+class NeutronTransport {
+public:
+    NeutronTransport(const ReactionRates& rates, double diffusion, const TransportOptions& options)
+        : options(options), nu(rates.nu), pool(options.threads) {
+        if (diffusion <= 0 || rates.leak <= 0) {
+            throw std::invalid_argument("输运模式要求扩散系数与漏失率为正数");
+        }
+        if (options.particles == 0 || options.batchSize == 0) {
+            throw std::invalid_argument("每代中子数与批大小必须为正数");
+        }
+        sigmaFission = rates.fission;
+        sigmaCapture = rates.absorption;
+        sigmaTotal = std::max(1.0 / (3.0 * diffusion), sigmaFission + sigmaCapture);
+        buckling = rates.leak / diffusion;
+        size = M_PI / std::sqrt(buckling);
+        diffusionK = nu * sigmaFission / (sigmaFission + sigmaCapture + diffusion * buckling);
+
+        const std::size_t batches = (options.particles + options.batchSize - 1) / options.batchSize;
+        workspaces.resize(batches);
+        tallies.resize(batches);
+        sourceX.resize(options.particles);
+        sourceY.resize(options.particles);
+        sourceZ.resize(options.particles);
+    }
+
+    double geometrySize() const { return size; }      // 平板厚度或球半径
+    double diffusionEstimate() const { return diffusionK; } // 单群扩散理论给出的 k
+
+    // 运行所有代，每代结束后调用 observer
+    void run(const std::function<void(const GenerationResult&)>& observer) {
+        initialSource();
+        double kNormalization = 1.0;
+        for (int generation = 0; generation < options.generations; ++generation) {
+            pool.parallelFor(0, options.particles, options.batchSize, [&](std::size_t begin, std::size_t end) {
+                const std::size_t batch = begin / options.batchSize;
+                transportBatch(generation, begin, end, kNormalization, workspaces[batch], tallies[batch]);
+            });
+
+            GenerationResult result;
+            result.generation = generation;
+            result.sites = 0;
+            for (std::size_t b = 0; b < tallies.size(); ++b) {
+                result.tally.add(tallies[b]);
+                result.sites += workspaces[b].bankX.size();
+            }
+            result.k = nu * result.tally.fissions / result.tally.histories;
+            if (observer) observer(result);
+            if (result.sites == 0) {
+                throw std::runtime_error("中子在第 " + std::to_string(generation) + " 代全部消失");
+            }
+            resampleSource(generation);
+            kNormalization = result.k;
+        }
+    }
+
+private:
+    // 一批中子的结构数组与各事件队列，跨代复用
+    struct BatchWorkspace {
+        std::vector<double> x, y, z, u, v, w;
+        std::vector<std::uint32_t> id, events;
+        std::vector<double> distance;
+        std::vector<double> boundary;                      // 沿飞行方向到边界的距离
+        std::vector<std::uint32_t> flightBits, reaction, direction0, direction1; // 本轮的随机数块
+        std::vector<std::uint32_t> collided, absorbed; // 本轮发生碰撞 / 吸收的中子在批内的下标
+        std::vector<unsigned char> alive;
+        std::vector<double> bankX, bankY, bankZ;     // 本批产生的裂变源点
+    };
+
+    TransportOptions options;
+    double nu;
+    double sigmaFission, sigmaCapture, sigmaTotal;
+    double buckling, size, diffusionK;
+    ThreadPool pool;
+    std::vector<BatchWorkspace> workspaces;
+    std::vector<TransportTally> tallies;
+    std::vector<double> sourceX, sourceY, sourceZ;
+
+    static const std::uint32_t POSITION_EVENT = 0xFFFFFFFFu;
+    static const std::uint32_t DIRECTION_EVENT = 0xFFFFFFFEu;
+    static const std::uint32_t RESAMPLE_EVENT = 0xFFFFFFFDu;
+
+    // (0, 1) 均匀数
+    static double uniform(std::uint32_t bits) { return (bits + 0.5) * (1.0 / 4294967296.0); }
+
+    void randomBlock(int generation, std::uint32_t event, std::uint32_t particle, std::uint32_t out[4]) const {
+        const std::uint32_t counter[4] = {event, particle, static_cast<std::uint32_t>(generation), 0};
+        Philox4x32::generate(counter, options.seed, out);
+    }
+
+    static void isotropic(const std::uint32_t bits[2], double& u, double& v, double& w) {
+        const double mu = 2.0 * uniform(bits[0]) - 1.0;
+        const double phi = 2.0 * M_PI * uniform(bits[1]);
+        const double s = std::sqrt(std::max(0.0, 1.0 - mu * mu));
+        u = mu;
+        v = s * std::cos(phi);
+        w = s * std::sin(phi);
+    }
+
+    // 以下为批内的向量化内核：各数组互不重叠（__restrict），循环内没有分支
+
+    // 每个中子取一个 Philox 随机数块，计数器为 (事件序号, 中子编号, 代)
+    static void randomKernel(std::size_t count, std::uint64_t seed, std::uint32_t generation,
+                             const std::uint32_t* __restrict events, const std::uint32_t* __restrict ids,
+                             std::uint32_t* __restrict out0, std::uint32_t* __restrict out1,
+                             std::uint32_t* __restrict out2, std::uint32_t* __restrict out3) {
+        for (std::size_t k = 0; k < count; ++k) {
+            const std::uint32_t counter[4] = {events[k], ids[k], generation, 0};
+            std::uint32_t bits[4];
+            Philox4x32::generate(counter, seed, bits);
+            out0[k] = bits[0];
+            out1[k] = bits[1];
+            out2[k] = bits[2];
+            out3[k] = bits[3];
         }
+    }
+
+    // 平板 |x| < half 沿 x 方向余弦 u 到边界的距离（u = 0 时为无穷大）
+    static void slabBoundaryKernel(std::size_t count, double half, const double* __restrict x,
+                                   const double* __restrict u, double* __restrict boundary) {
+        for (std::size_t k = 0; k < count; ++k) {
+            const double wall = u[k] > 0 ? half : -half;
+            boundary[k] = u[k] != 0 ? (wall - x[k]) / u[k] : std::numeric_limits<double>::infinity();
+        }
+    }
+
+    // 球 |r| < radius 内沿方向 (u, v, w) 到球面的距离
+    static void sphereBoundaryKernel(std::size_t count, double radius, const double* __restrict x,
+                                     const double* __restrict y, const double* __restrict z,
+                                     const double* __restrict u, const double* __restrict v,
+                                     const double* __restrict w, double* __restrict boundary) {
+        for (std::size_t k = 0; k < count; ++k) {
+            const double b = x[k] * u[k] + y[k] * v[k] + z[k] * w[k];
+            const double c = x[k] * x[k] + y[k] * y[k] + z[k] * z[k] - radius * radius;
+            boundary[k] = -b + std::sqrt(std::max(b * b - c, 0.0));
+        }
+    }
+
+    // 飞行距离小于到边界距离的中子移动到碰撞点并标记为存活，其余泄漏
+    static void moveKernel(std::size_t count, const double* __restrict distance, const double* __restrict boundary,
+                           const double* __restrict u, const double* __restrict v, const double* __restrict w,
+                           double* __restrict x, double* __restrict y, double* __restrict z,
+                           unsigned char* __restrict alive) {
+        for (std::size_t k = 0; k < count; ++k) {
+            const bool collides = distance[k] < boundary[k];
+            const double step = collides ? distance[k] : 0.0;
+            x[k] += step * u[k];
+            y[k] += step * v[k];
+            z[k] += step * w[k];
+            alive[k] = collides;
+        }
+    }
+
+    // 初始源在几何内均匀分布
+    void initialSource() {
+        for (std::size_t p = 0; p < options.particles; ++p) {
+            std::uint32_t bits[4];
+            randomBlock(-1, POSITION_EVENT, static_cast<std::uint32_t>(p), bits);
+            if (options.geometry == TransportGeometry::Slab) {
+                sourceX[p] = (uniform(bits[0]) - 0.5) * size;
+                sourceY[p] = 0.0;
+                sourceZ[p] = 0.0;
+            } else {
+                double u, v, w;
+                isotropic(bits + 1, u, v, w);
+                const double r = size * std::cbrt(uniform(bits[0]));
+                sourceX[p] = r * u;
+                sourceY[p] = r * v;
+                sourceZ[p] = r * w;
+            }
+        }
+    }
+
+    // 按批次顺序拼接各批的裂变源点，再系统抽样为固定的源中子数
+    void resampleSource(int generation) {
+        std::size_t sites = 0;
+        for (const BatchWorkspace& workspace : workspaces) sites += workspace.bankX.size();
+        std::uint32_t bits[4];
+        randomBlock(generation, RESAMPLE_EVENT, 0, bits);
+        const double offset = uniform(bits[0]);
+
+        std::size_t batch = 0, base = 0;
+        for (std::size_t p = 0; p < options.particles; ++p) {
+            std::size_t site = static_cast<std::size_t>((p + offset) * sites / options.particles);
+            while (site - base >= workspaces[batch].bankX.size()) {
+                base += workspaces[batch].bankX.size();
+                ++batch;
+            }
+            const BatchWorkspace& workspace = workspaces[batch];
+            sourceX[p] = workspace.bankX[site - base];
+            sourceY[p] = workspace.bankY[site - base];
+            sourceZ[p] = workspace.bankZ[site - base];
+        }
+    }
+
+    void transportBatch(int generation, std::size_t begin, std::size_t end, double kNormalization,
+                        BatchWorkspace& ws, TransportTally& tally) {
+        const std::size_t count = end - begin;
+        for (std::vector<double>* field : {&ws.x, &ws.y, &ws.z, &ws.u, &ws.v, &ws.w, &ws.distance, &ws.boundary}) {
+            field->resize(count);
+        }
+        for (std::vector<std::uint32_t>* field :
+             {&ws.id, &ws.events, &ws.flightBits, &ws.reaction, &ws.direction0, &ws.direction1}) {
+            field->resize(count);
+        }
+        ws.alive.resize(count);
+        ws.bankX.clear();
+        ws.bankY.clear();
+        ws.bankZ.clear();
+        tally = TransportTally();
+        tally.histories = static_cast<double>(count);
+
+        for (std::size_t k = 0; k < count; ++k) {
+            std::uint32_t bits[4];
+            const std::uint32_t particle = static_cast<std::uint32_t>(begin + k);
+            randomBlock(generation, DIRECTION_EVENT, particle, bits);
+            ws.x[k] = sourceX[begin + k];
+            ws.y[k] = sourceY[begin + k];
+            ws.z[k] = sourceZ[begin + k];
+            isotropic(bits, ws.u[k], ws.v[k], ws.w[k]);
+            ws.id[k] = particle;
+            ws.events[k] = 0;
+        }
+
+        const double scatterProbability = 1.0 - (sigmaFission + sigmaCapture) / sigmaTotal;
+        const double fissionProbability = sigmaFission / (sigmaFission + sigmaCapture);
+        const double inverseSigma = 1.0 / sigmaTotal;
+        const double yield = nu / kNormalization; // 每次裂变产生的源点期望数，按上一代 k 归一
+
+        std::size_t active = count;
+        while (active > 0) {
+            // 飞行：每个中子每轮取一个随机数块，第一个数抽样飞行距离，其余留给碰撞与吸收；
+            // 飞行距离与到边界的距离比较，没有越过边界的中子移动到碰撞点
+            randomKernel(active, options.seed, static_cast<std::uint32_t>(generation), ws.events.data(), ws.id.data(),
+                         ws.flightBits.data(), ws.reaction.data(), ws.direction0.data(), ws.direction1.data());
+            for (std::size_t k = 0; k < active; ++k) {
+                ws.distance[k] = -std::log(uniform(ws.flightBits[k])) * inverseSigma;
+            }
+            if (options.geometry == TransportGeometry::Slab) {
+                slabBoundaryKernel(active, 0.5 * size, ws.x.data(), ws.u.data(), ws.boundary.data());
+            } else {
+                sphereBoundaryKernel(active, size, ws.x.data(), ws.y.data(), ws.z.data(), ws.u.data(), ws.v.data(),
+                                     ws.w.data(), ws.boundary.data());
+            }
+            moveKernel(active, ws.distance.data(), ws.boundary.data(), ws.u.data(), ws.v.data(), ws.w.data(),
+                       ws.x.data(), ws.y.data(), ws.z.data(), ws.alive.data());
+            ws.collided.clear();
+            for (std::size_t k = 0; k < active; ++k) {
+                if (ws.alive[k]) ws.collided.push_back(static_cast<std::uint32_t>(k));
+            }
+            tally.leaks += static_cast<double>(active - ws.collided.size());
+            tally.collisions += static_cast<double>(ws.collided.size());
+
+            // 碰撞：散射的中子换一个各向同性的方向继续飞行，其余被吸收
+            ws.absorbed.clear();
+            for (std::uint32_t k : ws.collided) {
+                if (uniform(ws.reaction[k]) < scatterProbability) {
+                    const std::uint32_t bits[2] = {ws.direction0[k], ws.direction1[k]};
+                    isotropic(bits, ws.u[k], ws.v[k], ws.w[k]);
+                } else {
+                    ws.alive[k] = 0;
+                    ws.absorbed.push_back(k);
+                }
+            }
+            tally.absorptions += static_cast<double>(ws.absorbed.size());
+            tally.scatters += static_cast<double>(ws.collided.size() - ws.absorbed.size());
+
+            // 吸收：按 Σf / (Σf + Σc) 判断裂变，在吸收点存入 floor(ν / k + ξ) 个裂变源点
+            for (std::uint32_t k : ws.absorbed) {
+                if (uniform(ws.direction0[k]) >= fissionProbability) continue;
+                tally.fissions += 1.0;
+                const int sites = static_cast<int>(yield + uniform(ws.direction1[k]));
+                for (int s = 0; s < sites; ++s) {
+                    ws.bankX.push_back(ws.x[k]);
+                    ws.bankY.push_back(ws.y[k]);
+                    ws.bankZ.push_back(ws.z[k]);
+                }
+            }
+
+            // 压缩：存活的中子保持原有顺序移到前面
+            std::size_t kept = 0;
+            for (std::size_t k = 0; k < active; ++k) {
+                if (!ws.alive[k]) continue;
+                ws.x[kept] = ws.x[k];
+                ws.y[kept] = ws.y[k];
+                ws.z[kept] = ws.z[k];
+                ws.u[kept] = ws.u[k];
+                ws.v[kept] = ws.v[k];
+                ws.w[kept] = ws.w[k];
+                ws.id[kept] = ws.id[k];
+                ws.events[kept] = ws.events[k] + 1;
+                ++kept;
+            }
+            active = kept;
+        }
+    }
+};
+
+// 运行蒙特卡罗输运并输出每代的 k、泄漏比例与平均碰撞次数，最后给出有效代的 k 均值与标准误差
+int runTransport(const TransportOptions& options) {
+    ChainReaction reaction(2.5, 0.007, 0.1, 19.1, 10.0, 0.01, 0.005, 350.0, "reaction_log.txt");
+    NeutronTransport transport(reaction.rates(), reaction.diffusionCoefficient(), options);
+    std::cout << "geometry=" << (options.geometry == TransportGeometry::Slab ? "slab" : "sphere")
+              << " size=" << transport.geometrySize() << " k_diffusion=" << transport.diffusionEstimate() << std::endl;
+    std::cout << "generation,k,leakage,collisions_per_history,fission_sites" << std::endl;
+
+    double sum = 0.0, sumSquares = 0.0;
+    int active = 0;
+    auto start = std::chrono::steady_clock::now();
+    transport.run([&](const GenerationResult& result) {
+        std::cout << result.generation << "," << result.k << "," << result.tally.leaks / result.tally.histories << ","
+                  << result.tally.collisions / result.tally.histories << "," << result.sites << std::endl;
+        if (result.generation >= options.inactive) {
+            sum += result.k;
+            sumSquares += result.k * result.k;
+            ++active;
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (active > 0) {
+        const double mean = sum / active;
+        const double variance = active > 1 ? (sumSquares - active * mean * mean) / (active - 1) : 0.0;
+        std::cout << "k_eff=" << mean << " +/- " << std::sqrt(std::max(variance, 0.0) / active) << " over " << active
+                  << " active generations, " << seconds << " s" << std::endl;
+    }
+    return 0;
+}
+
+// 比较各积分器在相同终止时间下的步数、求值次数与终态误差；参考解为 rk45 在 1e-12 容差下的结果，
+// 误差以初始原子数归一（长时间后两个分量都趋于 0，逐分量的相对误差没有意义）
+int runIntegratorComparison(double endTime) {
+    ChainReaction reaction(2.5, 0.007, 0.1, 19.1, 10.0, 0.01, 0.005, 350.0, "reaction_log.txt");
+    const ReactionRates rates = reaction.rates();
+
+    IntegratorOptions referenceOptions;
+    referenceOptions.relativeTolerance = 1e-12;
+    referenceOptions.absoluteTolerance = 1e-12;
+    referenceOptions.step = 1e-6;
+    DormandPrinceIntegrator reference(referenceOptions);
+    double exact[2] = {reaction.initialAtoms(), 1.0};
+    reference.integrate(rates, 0.0, endTime, exact, ReactionIntegrator::Observer());
+
+    struct Case {
+        const char* name;
+        double tolerance; // 自适应方法的相对容差；euler 的步长
+    };
+    const Case cases[] = {{"euler", 1e-2}, {"euler", 1e-3}, {"euler", 1e-4},     {"rk45", 1e-4},
+                          {"rk45", 1e-6}, {"rk45", 1e-8},   {"rosenbrock", 1e-3}, {"rosenbrock", 1e-4},
+                          {"rosenbrock", 1e-5}};
+
+    std::cout << "integrator,tolerance_or_step,steps,rejected,evaluations,jacobians,seconds,error_vs_N0" << std::endl;
+    for (const Case& c : cases) {
+        IntegratorOptions options;
+        if (std::string(c.name) == "euler") {
+            options.step = c.tolerance;
+        } else {
+            options.relativeTolerance = c.tolerance;
+            options.absoluteTolerance = c.tolerance * 1e-3;
+        }
+        std::unique_ptr<ReactionIntegrator> integrator = makeIntegrator(c.name, options);
+        double y[2] = {reaction.initialAtoms(), 1.0};
+        auto start = std::chrono::steady_clock::now();
+        IntegrationStats stats = integrator->integrate(rates, 0.0, endTime, y, ReactionIntegrator::Observer());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double error = (std::fabs(y[0] - exact[0]) + std::fabs(y[1] - exact[1])) / reaction.initialAtoms();
+        std::cout << c.name << "," << c.tolerance << "," << stats.steps << "," << stats.rejected << ","
+                  << stats.evaluations << "," << stats.jacobians << "," << seconds << "," << error << std::endl;
+    }
+    return 0;
+}
+
+// 不确定性量化：构造函数的八个物理参数各自在 [low, high] 上均匀分布
+struct UQParameter {
+    const char* name;
+    double low;
+    double high;
+};
+
+const std::size_t UQ_PARAMETERS = 8;
+const std::size_t UQ_OUTPUTS = 3;
+const char* const UQ_OUTPUT_NAMES[UQ_OUTPUTS] = {"peak_neutrons", "peak_time", "fluence"};
+
+struct UQOptions {
+    // 默认范围为 main 中基准参数上下约 20%，温度取 300-400 K；顺序与构造函数一致
+    UQParameter parameters[UQ_PARAMETERS] = {
+        {"nu", 2.0, 3.0},          {"lambda", 0.005, 0.009},   {"beta", 0.05, 0.15},
+        {"density", 17.0, 21.0},   {"mass", 8.0, 12.0},        {"diffusion", 0.005, 0.015},
+        {"absorption", 0.002, 0.008}, {"temperature", 300.0, 400.0}};
+    std::size_t samples = 1024;    // Saltelli 方案的基础样本数 N，总运行次数为 N·(8 + 2)
+    bool sobolSequence = true;     // Sobol 低差异序列；否则为两组独立的拉丁超立方
+    std::string integrator = "rk45";
+    IntegratorOptions integratorOptions;
+    double endTime = 10.0;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::uint64_t seed = 12345;
+    std::size_t blockSamples = 32; // 每个任务处理的基础样本数
+};
+
+// Sobol 低差异序列（Bratley & Fox 的构造，方向数取自 Joe & Kuo 的 new-joe-kuo-6.21201 表前 16 维）。
+// 第 k 个点的第 j 维是 k 的各个置位比特对应方向数的异或
+class SobolSequence {
+public:
+    static const std::size_t MAX_DIMENSIONS = 16;
+    static const int BITS = 32;
+
+    explicit SobolSequence(std::size_t dimensions) : dimensions(dimensions), directions(dimensions * BITS) {
+        // 每维的本原多项式次数 s、内部系数 a 与初始方向数 m_1..m_s（第 1 维是 van der Corput 序列）
+        struct Polynomial {
+            int degree;
+            unsigned coefficients;
+            unsigned m[6];
+        };
+        static const Polynomial TABLE[MAX_DIMENSIONS - 1] = {
+            {1, 0, {1}},          {2, 1, {1, 3}},          {3, 1, {1, 3, 1}},         {3, 2, {1, 1, 1}},
+            {4, 1, {1, 1, 3, 3}}, {4, 4, {1, 3, 5, 13}},   {5, 2, {1, 1, 5, 5, 17}},  {5, 4, {1, 1, 5, 5, 5}},
+            {5, 7, {1, 1, 7, 11, 19}}, {5, 11, {1, 1, 5, 1, 1}}, {5, 13, {1, 1, 1, 3, 11}},
+            {5, 14, {1, 3, 5, 5, 31}}, {6, 1, {1, 3, 3, 9, 7, 49}}, {6, 13, {1, 1, 1, 15, 21, 21}},
+            {6, 16, {1, 3, 1, 13, 27, 49}}};
+        if (dimensions > MAX_DIMENSIONS) {
+            throw std::invalid_argument("Sobol 序列最多支持 16 维");
+        }
+
+        for (std::size_t j = 0; j < dimensions; ++j) {
+            std::uint32_t* v = &directions[j * BITS];
+            if (j == 0) {
+                for (int b = 0; b < BITS; ++b) v[b] = 1u << (BITS - 1 - b);
+                continue;
+            }
+            const Polynomial& p = TABLE[j - 1];
+            for (int b = 0; b < p.degree; ++b) v[b] = p.m[b] << (BITS - 1 - b);
+            for (int b = p.degree; b < BITS; ++b) {
+                v[b] = v[b - p.degree] ^ (v[b - p.degree] >> p.degree);
+                for (int c = 1; c < p.degree; ++c) {
+                    if ((p.coefficients >> (p.degree - 1 - c)) & 1u) v[b] ^= v[b - c];
+                }
+            }
+        }
+    }
+
+    // 第 index 个点，写入 point[0..dimensions)
+    void point(std::uint32_t index, double* point) const {
+        for (std::size_t j = 0; j < dimensions; ++j) {
+            const std::uint32_t* v = &directions[j * BITS];
+            std::uint32_t x = 0;
+            for (int b = 0; index >> b; ++b) {
+                if ((index >> b) & 1u) x ^= v[b];
+            }
+            point[j] = x * (1.0 / 4294967296.0);
+        }
+    }
+
+private:
+    std::size_t dimensions;
+    std::vector<std::uint32_t> directions;
+};
+
+// 每个工作线程独占一份：积分器与观察函数只在扫描开始时创建，之后的所有运行都复用
+// 自适应积分器的步长可达 0.1 量级，只看步端点会使峰值时刻按步长量化；因此在每个接受的步内
+// 用端点值与导数构造三次 Hermite 插值，峰值取插值多项式的极大值，fluence 取其精确积分
+struct UQWorkspace {
+    std::unique_ptr<ReactionIntegrator> integrator;
+    ReactionIntegrator::Observer observer;
+    const ReactionRates* rates = nullptr;
+    double peak = 0.0;
+    double peakTime = 0.0;
+    double fluence = 0.0;  // 中子数对时间的积分
+    double lastTime = 0.0;
+    double lastNeutrons = 0.0;
+    double lastSlope = 0.0; // 上一步端点处的 dI/dt
+
+    void start(const ReactionRates& r, const double y[2]) {
+        rates = &r;
+        double dydt[2];
+        rates->derivatives(y, dydt);
+        peak = lastNeutrons = y[1];
+        peakTime = lastTime = 0.0;
+        lastSlope = dydt[1];
+        fluence = 0.0;
+    }
+
+    void observe(double t, const double* y) {
+        double dydt[2];
+        rates->derivatives(y, dydt);
+        const double h = t - lastTime;
+        const double y0 = lastNeutrons, y1 = y[1];
+        const double d0 = h * lastSlope, d1 = h * dydt[1];
+
+        // p(s) = (2s³-3s²+1) y0 + (s³-2s²+s) d0 + (-2s³+3s²) y1 + (s³-s²) d1，s ∈ [0, 1]
+        fluence += h * (0.5 * (y0 + y1) + (d0 - d1) / 12.0);
+        const double a = 6.0 * (y0 - y1) + 3.0 * (d0 + d1);
+        const double b = -6.0 * (y0 - y1) - 4.0 * d0 - 2.0 * d1;
+        const double c = d0;
+        double roots[2];
+        int count = 0;
+        if (std::fabs(a) > 1e-14 * (std::fabs(b) + std::fabs(c))) {
+            const double discriminant = b * b - 4.0 * a * c;
+            if (discriminant >= 0) {
+                const double q = -0.5 * (b + std::copysign(std::sqrt(discriminant), b));
+                if (q != 0) roots[count++] = c / q;
+                roots[count++] = q / a;
+            }
+        } else if (b != 0) {
+            roots[count++] = -c / b;
+        }
+        for (int k = 0; k < count; ++k) {
+            const double u = roots[k];
+            if (!(u > 0.0 && u < 1.0)) continue;
+            const double value = (2 * u * u * u - 3 * u * u + 1) * y0 + (u * u * u - 2 * u * u + u) * d0 +
+                                 (-2 * u * u * u + 3 * u * u) * y1 + (u * u * u - u * u) * d1;
+            if (value > peak) {
+                peak = value;
+                peakTime = lastTime + u * h;
+            }
+        }
+        if (y1 > peak) {
+            peak = y1;
+            peakTime = t;
+        }
+        lastTime = t;
+        lastNeutrons = y1;
+        lastSlope = dydt[1];
+    }
+};
+
+// 用 Saltelli 方案做全局敏感性分析：每个基础样本 k 有矩阵 A、B 的两行，以及把 A 的第 i 列换成 B 的第 i 列的
+// 8 行 AB_i，共 10 次运行。设计矩阵与输出都预先分配在内存中，运行期间不做文件读写；
+// 样本按固定大小的块分给工作线程，每块写入互不重叠的输出，归约在全部完成后按样本顺序进行，结果与线程数无关。
+// 一阶指数用 Saltelli (2010) 估计 S_i = E[f(B)(f(AB_i) - f(A))] / V，总效应指数用 Jansen 估计
+// ST_i = E[(f(A) - f(AB_i))²] / 2V
+class UQSweep {
+public:
+    static const std::size_t ROWS = UQ_PARAMETERS + 2; // 每个基础样本的运行次数
+
+    explicit UQSweep(const UQOptions& options) : options(options) {
+        for (std::size_t i = 0; i < UQ_PARAMETERS; ++i) {
+            const UQParameter& p = options.parameters[i];
+            if (!(p.low <= p.high)) throw std::invalid_argument(std::string("参数范围无效: ") + p.name);
+            // 与构造函数相同的检查：裂变截面、密度、质量与温度为正，其余非负
+            const bool positive = i == 1 || i == 3 || i == 4 || i == 7;
+            if (positive ? p.low <= 0 : p.low < 0) {
+                throw std::invalid_argument("参数必须为非负数，且裂变截面、密度和质量必须为正数");
+            }
+        }
+        if (options.samples < 2) throw std::invalid_argument("至少需要 2 个基础样本");
+    }
+
+    std::size_t runs() const { return options.samples * ROWS; }
+
+    // 生成设计矩阵并执行全部运行
+    void run() {
+        buildDesign();
+        outputs.assign(runs() * UQ_OUTPUTS, 0.0);
+
+        WorkStealingPool pool(std::max(1u, options.threads));
+        std::vector<UQWorkspace> workspaces(pool.size());
+        for (UQWorkspace& ws : workspaces) {
+            ws.integrator = makeIntegrator(options.integrator, options.integratorOptions);
+            UQWorkspace* self = &ws;
+            ws.observer = [self](double t, const double* y) { self->observe(t, y); };
+        }
+
+        for (std::size_t begin = 0; begin < options.samples; begin += options.blockSamples) {
+            const std::size_t end = std::min(begin + options.blockSamples, options.samples);
+            pool.submit([this, &workspaces, begin, end](unsigned worker) {
+                UQWorkspace& ws = workspaces[worker];
+                for (std::size_t row = begin * ROWS; row < end * ROWS; ++row) evaluate(ws, row);
+            });
+        }
+        pool.wait();
+    }
+
+    // 矩阵 A、B 的输出（2N 个独立样本）的汇总统计
+    void printSummary(std::ostream& out) const {
+        std::vector<double> values(2 * options.samples);
+        out << "quantity,mean,std,min,p05,median,p95,max" << std::endl;
+        for (std::size_t q = 0; q < UQ_OUTPUTS; ++q) {
+            for (std::size_t k = 0; k < options.samples; ++k) {
+                values[2 * k] = output(k, 0, q);
+                values[2 * k + 1] = output(k, 1, q);
+            }
+            double mean = 0.0, m2 = 0.0;
+            for (std::size_t k = 0; k < values.size(); ++k) {
+                const double delta = values[k] - mean;
+                mean += delta / (k + 1);
+                m2 += delta * (values[k] - mean);
+            }
+            std::sort(values.begin(), values.end());
+            out << UQ_OUTPUT_NAMES[q] << "," << mean << "," << std::sqrt(m2 / (values.size() - 1)) << ","
+                << values.front() << "," << quantile(values, 0.05) << "," << quantile(values, 0.5) << ","
+                << quantile(values, 0.95) << "," << values.back() << std::endl;
+        }
+    }
+
+    void printSobolIndices(std::ostream& out) const {
+        out << "quantity,parameter,S1,ST" << std::endl;
+        const double n = static_cast<double>(options.samples);
+        for (std::size_t q = 0; q < UQ_OUTPUTS; ++q) {
+            double mean = 0.0;
+            for (std::size_t k = 0; k < options.samples; ++k) mean += output(k, 0, q) + output(k, 1, q);
+            mean /= 2 * n;
+            double variance = 0.0;
+            for (std::size_t k = 0; k < options.samples; ++k) {
+                const double a = output(k, 0, q) - mean, b = output(k, 1, q) - mean;
+                variance += a * a + b * b;
+            }
+            variance /= 2 * n - 1;
+
+            for (std::size_t i = 0; i < UQ_PARAMETERS; ++i) {
+                double first = 0.0, total = 0.0;
+                for (std::size_t k = 0; k < options.samples; ++k) {
+                    const double a = output(k, 0, q), b = output(k, 1, q) - mean, ab = output(k, 2 + i, q);
+                    first += b * (ab - a);
+                    total += (a - ab) * (a - ab);
+                }
+                const double s1 = variance > 0 ? first / n / variance : 0.0;
+                const double st = variance > 0 ? total / (2 * n) / variance : 0.0;
+                out << UQ_OUTPUT_NAMES[q] << "," << options.parameters[i].name << "," << s1 << "," << st << std::endl;
+            }
+        }
+    }
+
+private:
+    UQOptions options;
+    std::vector<double> design;  // runs() × 8，按运行顺序存放参数
+    std::vector<double> outputs; // runs() × UQ_OUTPUTS
+
+    double output(std::size_t sample, std::size_t row, std::size_t quantity) const {
+        return outputs[(sample * ROWS + row) * UQ_OUTPUTS + quantity];
+    }
+
+    static double quantile(const std::vector<double>& sorted, double p) {
+        const double position = p * (sorted.size() - 1);
+        const std::size_t lower = static_cast<std::size_t>(position);
+        const std::size_t upper = std::min(lower + 1, sorted.size() - 1);
+        return sorted[lower] + (position - lower) * (sorted[upper] - sorted[lower]);
+    }
 
-        // 生成CSV数据文件
-        std::ofstream csvFile("reaction_data.csv");
-        if (!csvFile) {
-            throw std::runtime_error("无法打开CSV文件");
+    // 先在 [0,1)^16 中取 A、B 两组单位样本，再按范围缩放并展开为 10 行
+    void buildDesign() {
+        const std::size_t n = options.samples;
+        const std::size_t columns = 2 * UQ_PARAMETERS;
+        std::vector<double> unit(n * columns);
+        if (options.sobolSequence) {
+            SobolSequence sequence(columns);
+            for (std::size_t k = 0; k < n; ++k) {
+                // 跳过全零的第 0 个点
+                sequence.point(static_cast<std::uint32_t>(k + 1), &unit[k * columns]);
+            }
+        } else {
+            std::vector<std::size_t> strata(n);
+            for (std::size_t c = 0; c < columns; ++c) {
+                PhiloxRNG rng(options.seed, c);
+                for (std::size_t k = 0; k < n; ++k) strata[k] = k;
+                for (std::size_t k = n - 1; k > 0; --k) {
+                    std::swap(strata[k], strata[rng.nextUInt() % (k + 1)]);
+                }
+                for (std::size_t k = 0; k < n; ++k) {
+                    unit[k * columns + c] = (strata[k] + rng.uniformDouble()) / n;
+                }
+            }
         }
-        csvFile << "时间(s),原子核数量,中子数量\n";
-        for (const auto& result : results) {
-            csvFile << result.first << "," << result.second << "\n";
+
+        design.resize(runs() * UQ_PARAMETERS);
+        for (std::size_t k = 0; k < n; ++k) {
+            const double* a = &unit[k * columns];
+            const double* b = a + UQ_PARAMETERS;
+            for (std::size_t row = 0; row < ROWS; ++row) {
+                double* x = &design[(k * ROWS + row) * UQ_PARAMETERS];
+                for (std::size_t i = 0; i < UQ_PARAMETERS; ++i) {
+                    const bool fromB = row == 1 || row == 2 + i;
+                    const UQParameter& p = options.parameters[i];
+                    x[i] = p.low + (fromB ? b[i] : a[i]) * (p.high - p.low);
+                }
+            }
         }
     }
+
+    // 一次运行：峰值中子数及其时刻、fluence 均取自各接受步内的 Hermite 插值（见 UQWorkspace）
+    void evaluate(UQWorkspace& ws, std::size_t row) {
+        const double* x = &design[row * UQ_PARAMETERS];
+        const ReactionRates rates = ChainReaction::ratesFor(x[0], x[1], x[2], x[5], x[6], x[7]);
+        double y[2] = {x[3] * x[4], 1.0}; // 初始原子数 = 质量 × 密度
+        ws.start(rates, y);
+        ws.integrator->integrate(rates, 0.0, options.endTime, y, ws.observer);
+
+        double* result = &outputs[row * UQ_OUTPUTS];
+        result[0] = ws.peak;
+        result[1] = ws.peakTime;
+        result[2] = ws.fluence;
+    }
 };
 
-int main() {
+int runUQSweep(const UQOptions& options) {
+    UQSweep sweep(options);
+    auto start = std::chrono::steady_clock::now();
+    sweep.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "sampling=" << (options.sobolSequence ? "sobol" : "lhs") << " samples=" << options.samples
+              << " runs=" << sweep.runs() << " integrator=" << options.integrator << " threads=" << options.threads
+              << " seconds=" << seconds << " runs_per_second=" << sweep.runs() / seconds << std::endl;
+    sweep.printSummary(std::cout);
+    sweep.printSobolIndices(std::cout);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string integratorName;
+    IntegratorOptions options;
+    double endTime = 10.0;
+    bool compare = false;
+    bool transport = false;
+    TransportOptions transportOptions;
+    bool uq = false;
+    UQOptions uqOptions;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--integrator" && a + 1 < argc) {
+            integratorName = argv[++a];
+        } else if (arg == "--rtol" && a + 1 < argc) {
+            options.relativeTolerance = std::atof(argv[++a]);
+        } else if (arg == "--atol" && a + 1 < argc) {
+            options.absoluteTolerance = std::atof(argv[++a]);
+        } else if (arg == "--step" && a + 1 < argc) {
+            options.step = std::atof(argv[++a]);
+        } else if (arg == "--end" && a + 1 < argc) {
+            endTime = std::atof(argv[++a]);
+        } else if (arg == "--compare") {
+            compare = true;
+        } else if (arg == "--transport" && a + 1 < argc) {
+            transport = true;
+            std::string geometry = argv[++a];
+            if (geometry != "slab" && geometry != "sphere") {
+                std::cerr << "未知的几何: " << geometry << std::endl;
+                return 1;
+            }
+            transportOptions.geometry = geometry == "slab" ? TransportGeometry::Slab : TransportGeometry::Sphere;
+        } else if (arg == "--particles" && a + 1 < argc) {
+            transportOptions.particles = std::strtoul(argv[++a], nullptr, 10);
+        } else if (arg == "--generations" && a + 1 < argc) {
+            transportOptions.generations = std::atoi(argv[++a]);
+        } else if (arg == "--inactive" && a + 1 < argc) {
+            transportOptions.inactive = std::atoi(argv[++a]);
+        } else if (arg == "--threads" && a + 1 < argc) {
+            transportOptions.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++a])));
+            uqOptions.threads = transportOptions.threads;
+        } else if (arg == "--seed" && a + 1 < argc) {
+            transportOptions.seed = std::strtoull(argv[++a], nullptr, 10);
+            uqOptions.seed = transportOptions.seed;
+        } else if (arg == "--uq" && a + 1 < argc) {
+            uq = true;
+            uqOptions.samples = std::strtoul(argv[++a], nullptr, 10);
+        } else if (arg == "--sampling" && a + 1 < argc) {
+            std::string sampling = argv[++a];
+            if (sampling != "sobol" && sampling != "lhs") {
+                std::cerr << "未知的抽样方法: " << sampling << std::endl;
+                return 1;
+            }
+            uqOptions.sobolSequence = sampling == "sobol";
+        } else if (arg == "--range" && a + 3 < argc) {
+            std::string name = argv[++a];
+            UQParameter* parameter = nullptr;
+            for (UQParameter& p : uqOptions.parameters) {
+                if (name == p.name) parameter = &p;
+            }
+            if (!parameter) {
+                std::cerr << "未知的参数: " << name << std::endl;
+                return 1;
+            }
+            parameter->low = std::atof(argv[++a]);
+            parameter->high = std::atof(argv[++a]);
+        } else {
+            std::cerr << "用法: " << argv[0]
+                      << " [--integrator euler|rk45|rosenbrock] [--rtol R] [--atol A] [--step H] [--end T] [--compare]"
+                      << " [--transport slab|sphere [--particles N] [--generations G] [--inactive I] [--threads T] [--seed S]]"
+                      << " [--uq N [--sampling sobol|lhs] [--range NAME LOW HIGH] [--threads T] [--seed S]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
     try {
+        if (compare) {
+            return runIntegratorComparison(endTime);
+        }
+        if (transport) {
+            return runTransport(transportOptions);
+        }
+        if (uq) {
+            if (!integratorName.empty()) uqOptions.integrator = integratorName;
+            uqOptions.integratorOptions = options;
+            uqOptions.endTime = endTime;
+            return runUQSweep(uqOptions);
+        }
         ChainReaction reaction(2.5, 0.007, 0.1, 19.1, 10.0, 0.01, 0.005, 350.0, "reaction_log.txt");
-        reaction.simulate(10.0, 0.1);
+        if (integratorName.empty()) {
+            reaction.simulate(10.0, 0.1);
+        } else {
+            std::unique_ptr<ReactionIntegrator> integrator = makeIntegrator(integratorName, options);
+            IntegrationStats stats = reaction.simulate(endTime, *integrator);
+            std::cout << integrator->name() << ": " << stats.steps << " 步（拒绝 " << stats.rejected << " 步），"
+                      << stats.evaluations << " 次右端求值" << std::endl;
+        }
         std::cout << "模拟完成，数据已输出到 reaction_log.txt 和 reaction_data.csv" << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "错误: " << e.what() << std::endl;
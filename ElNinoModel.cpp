@@ -5,6 +5,17 @@
 #include <sstream>
 #include <iomanip>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include "ThreadPool.h"
+#include "Philox.h"
+#include "TimeSeriesSink.h"
 
 class ElNinoModel {
 public:
@@ -16,20 +27,21 @@ public:
     }
 
     void simulate(int days) {
+        history.reserve(history.size() + static_cast<std::size_t>(std::max(days, 0)));
         for (int day = 0; day < days; ++day) {
             // 分数調波解の計算ロジックをここに実装
             double new_infected = beta * S * I; // シンプルな感染モデル
             double new_recovered = gamma * I; // 回復者数
 
             // 状態の更新
-            S -= new_infected; 
+            S -= new_infected;
             I += new_infected - new_recovered;
 
             // 各人口が負にならないようにクリッピング
             clip_values();
-            
-            // ログの記録
-            logs.push_back(format_log(day, S, I));
+
+            // 数値のまま記録し、文字列への整形は保存時に行う
+            history.push_back(Record{day, S, I});
         }
     }
 
@@ -40,8 +52,8 @@ public:
         }
 
         file << "Day,Susceptible,Infectious\n";
-        for (const auto &log : logs) {
-            file << log << "\n";
+        for (const auto &record : history) {
+            file << format_log(record.day, record.S, record.I) << "\n";
         }
         file.close();
     }
@@ -53,18 +65,24 @@ public:
         }
 
         log_file << "Day,Susceptible,Infectious\n";
-        for (const auto &log : logs) {
-            log_file << log << "\n";
+        for (const auto &record : history) {
+            log_file << format_log(record.day, record.S, record.I) << "\n";
         }
         log_file.close();
     }
 
 private:
+    struct Record {
+        int day;
+        double S;
+        double I;
+    };
+
     double beta; // 感染率
     double gamma; // 回復率
     double S; // 感受性人口
     double I; // 感染者人口
-    std::vector<std::string> logs;
+    std::vector<Record> history;
 
     void clip_values() {
         if (S < 0) S = 0;
@@ -78,24 +96,340 @@ private:
     }
 };
 
-int main() {
+// アンサンブル予報の設定。各メンバーの beta・gamma・初期感受性人口は基準値に
+// 一様分布の相対摂動 (1 + spread * u, u ∈ [-1, 1)) を掛けたもの
+struct EnsembleOptions {
+    std::size_t members = 100000;
+    int days = 100;
+    double beta_spread = 0.1;
+    double gamma_spread = 0.1;
+    double initial_spread = 0.1;
+    double initial_infectious = 1.0;  // 初期感染者数（0 のままでは流行が始まらない）
+    std::size_t block_size = 2048;    // 1 タスクが全日程を通して受け持つメンバー数（キャッシュに収まる大きさ）
+    int trajectory_stride = 0;         // 軌道を保存する間隔（日）。0（既定）なら保存せず、分位点と平均だけを求める
+    unsigned threads = std::thread::hardware_concurrency();
+    std::uint64_t seed = 2024;
+};
+
+// 多数のメンバーを同時に積分するアンサンブル。状態とパラメータはメンバーごとの連続配列（SoA）に置き、
+// 1 日分の更新は __restrict 付きのカーネルで SIMD レーンにまとめて計算する。
+// メンバーはブロック単位でワーカーに割り当て、各ブロックは全日程を続けて積分するので状態がキャッシュに残る。
+// 分位点は積分中に全ワーカー共有の日ごとのヒストグラム（整数カウント）へ加算して求め、平均はブロックごとの和を
+// ブロック順に足し合わせる。どちらの結果もスレッド数に依存しない。積分ループ内では文字列を一切作らない。
+// クリッピングがあると S + I は初期総人口を超えうるので、ヒストグラムは値の範囲を仮定しない対数線形区間
+// （double の指数と仮数の上位 HISTOGRAM_SUB_BITS ビット）とし、分位点の相対誤差は 2^-7 程度に収まる。
+class ElNinoEnsemble {
+public:
+    static const int QUANTILE_COUNT = 5;
+    static const double QUANTILES[QUANTILE_COUNT];
+    enum Variable { SUSCEPTIBLE = 0, INFECTIOUS = 1, VARIABLE_COUNT = 2 };
+
+    ElNinoEnsemble(double beta, double gamma, int initial_conditions, const EnsembleOptions &options)
+        : options(options) {
+        if (initial_conditions < 0) {
+            throw std::invalid_argument("Initial conditions cannot be negative.");
+        }
+        if (options.members == 0 || options.days <= 0 || options.block_size == 0 || options.trajectory_stride < 0) {
+            throw std::invalid_argument("Invalid ensemble options.");
+        }
+
+        const std::size_t n = options.members;
+        member_beta.resize(n);
+        member_gamma.resize(n);
+        S.resize(n);
+        I.resize(n);
+        for (std::size_t m = 0; m < n; ++m) {
+            PhiloxRNG rng(options.seed, m);
+            member_beta[m] = beta * (1.0 + options.beta_spread * (2.0 * rng.uniformDouble() - 1.0));
+            member_gamma[m] = gamma * (1.0 + options.gamma_spread * (2.0 * rng.uniformDouble() - 1.0));
+            S[m] = std::max(0.0, initial_conditions * (1.0 + options.initial_spread * (2.0 * rng.uniformDouble() - 1.0)));
+            I[m] = options.initial_infectious;
+        }
+
+        block_count = (n + options.block_size - 1) / options.block_size;
+        stored = options.trajectory_stride > 0 ? (options.days + options.trajectory_stride - 1) / options.trajectory_stride : 0;
+        trajectory[SUSCEPTIBLE].resize(static_cast<std::size_t>(stored) * n);
+        trajectory[INFECTIOUS].resize(static_cast<std::size_t>(stored) * n);
+    }
+
+    void run() {
+        const std::size_t days = static_cast<std::size_t>(options.days);
+        WorkStealingPool pool(std::max(1u, options.threads));
+        histograms = std::vector<std::atomic<std::uint32_t>>(days * VARIABLE_COUNT * HISTOGRAM_BINS);
+        worker_counts.assign(pool.size() * HISTOGRAM_BINS, 0);
+        block_sums.assign(block_count * days * VARIABLE_COUNT, 0.0);
+
+        for (std::size_t block = 0; block < block_count; ++block) {
+            pool.submit([this, block](unsigned worker) { run_block(block, worker); });
+        }
+        pool.wait();
+        summarize();
+    }
+
+    std::size_t members() const { return options.members; }
+    int days() const { return options.days; }
+
+    // 保存した k 番目の日（day = k * trajectory_stride）の全メンバーの値
+    int stored_days() const { return stored; }
+    const float *trajectory_of(Variable variable, int k) const {
+        return &trajectory[variable][static_cast<std::size_t>(k) * options.members];
+    }
+    std::size_t trajectory_bytes() const {
+        return (trajectory[SUSCEPTIBLE].size() + trajectory[INFECTIOUS].size()) * sizeof(float);
+    }
+
+    double mean(Variable variable, int day) const { return means[day * VARIABLE_COUNT + variable]; }
+    double quantile(Variable variable, int day, int q) const {
+        return quantile_values[(day * VARIABLE_COUNT + variable) * QUANTILE_COUNT + q];
+    }
+
+    // 日ごとの平均と分位点を CSV に保存する（整形と書き込みは呼び出したスレッドで同期的に行う）
+    void save_quantiles(const std::string &filename) const {
+        std::vector<std::string> columns = {"Day"};
+        const char *names[VARIABLE_COUNT] = {"Susceptible", "Infectious"};
+        for (int v = 0; v < VARIABLE_COUNT; ++v) {
+            columns.push_back(std::string(names[v]) + "_mean");
+            for (int q = 0; q < QUANTILE_COUNT; ++q) {
+                columns.push_back(std::string(names[v]) + "_p" + std::to_string(static_cast<int>(QUANTILES[q] * 100 + 0.5)));
+            }
+        }
+        SinkOptions sink_options;
+        sink_options.threaded = false; // 積分後に日数分の行を書くだけなので同期書き込み
+        TimeSeriesSink sink(filename, columns, sink_options);
+        std::vector<double> row(columns.size());
+        for (int day = 0; day < options.days; ++day) {
+            std::size_t c = 0;
+            row[c++] = day;
+            for (int v = 0; v < VARIABLE_COUNT; ++v) {
+                row[c++] = mean(static_cast<Variable>(v), day);
+                for (int q = 0; q < QUANTILE_COUNT; ++q) row[c++] = quantile(static_cast<Variable>(v), day, q);
+            }
+            sink.append(row.data());
+        }
+        sink.close();
+    }
+
+private:
+    EnsembleOptions options;
+    std::vector<double> member_beta;
+    std::vector<double> member_gamma;
+    std::vector<double> S;
+    std::vector<double> I;
+    std::vector<float> trajectory[VARIABLE_COUNT]; // 日ごとに全メンバーを連続して格納
+    int stored = 0;
+    std::size_t block_count = 0;
+
+    // 区間 0 は [0, 2^MIN_EXPONENT)、最後の区間は 2^MAX_EXPONENT 以上（NaN を含む）
+    static const int HISTOGRAM_SUB_BITS = 7;
+    static const int HISTOGRAM_MIN_EXPONENT = -20;
+    static const int HISTOGRAM_MAX_EXPONENT = 44;
+    static const std::size_t HISTOGRAM_BINS =
+        (static_cast<std::size_t>(HISTOGRAM_MAX_EXPONENT - HISTOGRAM_MIN_EXPONENT) << HISTOGRAM_SUB_BITS) + 2;
+
+    // ワーカーはブロックの 1 日・1 変数分を手元の区間表に数えてから共有表へ足し込むので、
+    // 共有表の大きさはスレッド数に依存せず、アトミック加算は使われた区間の数だけで済む
+    std::vector<std::atomic<std::uint32_t>> histograms; // [日][変数][区間]
+    std::vector<std::uint32_t> worker_counts;           // [ワーカー][区間]（足し込み後は 0 に戻す）
+    std::vector<double> block_sums;                     // [ブロック][日][変数]
+    std::vector<double> means;                          // [日][変数]
+    std::vector<double> quantile_values;                // [日][変数][分位点]
+
+    // 1 日分の更新。ElNinoModel::simulate と同じ式とクリッピング
+    static void step_members(double *__restrict S, double *__restrict I, const double *__restrict beta,
+                             const double *__restrict gamma, std::size_t n) {
+        for (std::size_t m = 0; m < n; ++m) {
+            const double new_infected = beta[m] * S[m] * I[m];
+            const double new_recovered = gamma[m] * I[m];
+            const double s = S[m] - new_infected;
+            const double i = I[m] + new_infected - new_recovered;
+            S[m] = s < 0 ? 0.0 : s;
+            I[m] = i < 0 ? 0.0 : i;
+        }
+    }
+
+    static void store_members(const double *__restrict values, float *__restrict out, std::size_t n) {
+        for (std::size_t m = 0; m < n; ++m) out[m] = static_cast<float>(values[m]);
+    }
+
+    static std::uint64_t histogram_key(double value) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits >> (52 - HISTOGRAM_SUB_BITS);
+    }
+
+    static std::size_t histogram_bin(double value) {
+        static const double low = std::ldexp(1.0, HISTOGRAM_MIN_EXPONENT);
+        static const double high = std::ldexp(1.0, HISTOGRAM_MAX_EXPONENT);
+        static const std::uint64_t first = histogram_key(low);
+        if (value < low) return 0;
+        if (!(value < high)) return HISTOGRAM_BINS - 1;
+        return static_cast<std::size_t>(histogram_key(value) - first) + 1;
+    }
+
+    // 区間 bin の下端
+    static double histogram_edge(std::size_t bin) {
+        if (bin == 0) return 0.0;
+        const std::uint64_t bits = (histogram_key(std::ldexp(1.0, HISTOGRAM_MIN_EXPONENT)) + bin - 1)
+                                   << (52 - HISTOGRAM_SUB_BITS);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // ブロックの値を手元の counts に数え、使われた区間の範囲だけ共有表へ足し込んで counts を 0 に戻す
+    static void accumulate(const double *values, std::size_t n, std::uint32_t *counts,
+                           std::atomic<std::uint32_t> *histogram, double &sum) {
+        double total = 0.0;
+        std::size_t first = HISTOGRAM_BINS, last = 0;
+        for (std::size_t m = 0; m < n; ++m) {
+            total += values[m];
+            const std::size_t bin = histogram_bin(values[m]);
+            first = std::min(first, bin);
+            last = std::max(last, bin);
+            ++counts[bin];
+        }
+        sum = total;
+        // カウントは足し合わせる順序によらないので relaxed で十分
+        for (std::size_t bin = first; bin <= last; ++bin) {
+            if (counts[bin] == 0) continue;
+            histogram[bin].fetch_add(counts[bin], std::memory_order_relaxed);
+            counts[bin] = 0;
+        }
+    }
+
+    void run_block(std::size_t block, unsigned worker) {
+        const std::size_t begin = block * options.block_size;
+        const std::size_t n = std::min(options.block_size, options.members - begin);
+        const std::size_t bins = HISTOGRAM_BINS;
+        double *block_S = &S[begin];
+        double *block_I = &I[begin];
+        std::uint32_t *counts = &worker_counts[worker * bins];
+        double *sums = &block_sums[block * options.days * VARIABLE_COUNT];
+
+        for (int day = 0; day < options.days; ++day) {
+            step_members(block_S, block_I, &member_beta[begin], &member_gamma[begin], n);
+
+            std::atomic<std::uint32_t> *histogram = &histograms[static_cast<std::size_t>(day) * VARIABLE_COUNT * bins];
+            accumulate(block_S, n, counts, histogram, sums[day * VARIABLE_COUNT + SUSCEPTIBLE]);
+            accumulate(block_I, n, counts, histogram + bins, sums[day * VARIABLE_COUNT + INFECTIOUS]);
+            if (stored > 0 && day % options.trajectory_stride == 0) {
+                const std::size_t offset = static_cast<std::size_t>(day / options.trajectory_stride) * options.members + begin;
+                store_members(block_S, &trajectory[SUSCEPTIBLE][offset], n);
+                store_members(block_I, &trajectory[INFECTIOUS][offset], n);
+            }
+        }
+    }
+
+    // 共有ヒストグラムから、区間内は一様分布と見なして分位点を線形補間する
+    void summarize() {
+        const std::size_t days = static_cast<std::size_t>(options.days);
+        const std::size_t bins = HISTOGRAM_BINS;
+
+        means.assign(days * VARIABLE_COUNT, 0.0);
+        for (std::size_t block = 0; block < block_count; ++block) {
+            for (std::size_t k = 0; k < days * VARIABLE_COUNT; ++k) means[k] += block_sums[block * days * VARIABLE_COUNT + k];
+        }
+        for (double &value : means) value /= options.members;
+
+        quantile_values.assign(days * VARIABLE_COUNT * QUANTILE_COUNT, 0.0);
+        for (std::size_t k = 0; k < days * VARIABLE_COUNT; ++k) {
+            const std::atomic<std::uint32_t> *histogram = &histograms[k * bins];
+            std::size_t bin = 0;
+            double below = 0.0;
+            for (int q = 0; q < QUANTILE_COUNT; ++q) {
+                const double target = QUANTILES[q] * options.members;
+                while (bin + 1 < bins && below + histogram[bin].load(std::memory_order_relaxed) < target) {
+                    below += histogram[bin++].load(std::memory_order_relaxed);
+                }
+                const double count = histogram[bin].load(std::memory_order_relaxed);
+                const double fraction = count > 0 ? (target - below) / count : 0.0;
+                const double lower = histogram_edge(bin);
+                // 区間 0 は 0 とみなし、最後の区間は下端を返す
+                const double upper = bin > 0 && bin + 1 < bins ? histogram_edge(bin + 1) : lower;
+                quantile_values[k * QUANTILE_COUNT + q] = lower + std::min(std::max(fraction, 0.0), 1.0) * (upper - lower);
+            }
+        }
+        histograms = std::vector<std::atomic<std::uint32_t>>();
+        worker_counts = std::vector<std::uint32_t>();
+    }
+};
+
+const double ElNinoEnsemble::QUANTILES[ElNinoEnsemble::QUANTILE_COUNT] = {0.05, 0.25, 0.5, 0.75, 0.95};
+
+// アンサンブルを実行し、処理速度と最終日の分位点を表示して日ごとの統計を CSV に保存する
+int run_ensemble(double beta, double gamma, int initial_conditions, const EnsembleOptions &options) {
+    ElNinoEnsemble ensemble(beta, gamma, initial_conditions, options);
+    auto start = std::chrono::steady_clock::now();
+    ensemble.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const int last = options.days - 1;
+    std::cout << "members=" << options.members << " days=" << options.days << " threads=" << options.threads
+              << " seconds=" << seconds << " member_days_per_second=" << options.members * options.days / seconds
+              << " trajectory_bytes=" << ensemble.trajectory_bytes() << std::endl;
+    std::cout << "Day " << last << " Infectious: mean=" << ensemble.mean(ElNinoEnsemble::INFECTIOUS, last);
+    for (int q = 0; q < ElNinoEnsemble::QUANTILE_COUNT; ++q) {
+        std::cout << " p" << static_cast<int>(ElNinoEnsemble::QUANTILES[q] * 100 + 0.5) << "="
+                  << ensemble.quantile(ElNinoEnsemble::INFECTIOUS, last, q);
+    }
+    std::cout << std::endl;
+
+    std::string filename = "elnino_ensemble_quantiles.csv";
+    ensemble.save_quantiles(filename);
+    std::cout << "Ensemble statistics saved to " << filename << "." << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool ensemble = false;
+    EnsembleOptions ensemble_options;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--ensemble" && a + 1 < argc) {
+            ensemble = true;
+            ensemble_options.members = std::strtoul(argv[++a], nullptr, 10);
+        } else if (arg == "--days" && a + 1 < argc) {
+            ensemble_options.days = std::atoi(argv[++a]);
+        } else if (arg == "--spread" && a + 1 < argc) {
+            const double spread = std::atof(argv[++a]);
+            ensemble_options.beta_spread = ensemble_options.gamma_spread = ensemble_options.initial_spread = spread;
+        } else if (arg == "--initial-infectious" && a + 1 < argc) {
+            ensemble_options.initial_infectious = std::atof(argv[++a]);
+        } else if (arg == "--stride" && a + 1 < argc) {
+            ensemble_options.trajectory_stride = std::atoi(argv[++a]);
+        } else if (arg == "--threads" && a + 1 < argc) {
+            ensemble_options.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++a])));
+        } else if (arg == "--seed" && a + 1 < argc) {
+            ensemble_options.seed = std::strtoull(argv[++a], nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--ensemble MEMBERS [--days D] [--spread F] [--initial-infectious I] [--stride K]"
+                      << " [--threads T] [--seed S]]" << std::endl;
+            return 1;
+        }
+    }
+
     try {
         double beta = 0.2; // 感染率
         double gamma = 0.1; // 回復率
         int initial_conditions = 1000; // 初期条件
 
+        if (ensemble) {
+            return run_ensemble(beta, gamma, initial_conditions, ensemble_options);
+        }
+
         ElNinoModel model(beta, gamma, initial_conditions);
-        
+
         int days = 100; // シミュレーション日数
         model.simulate(days);
-        
+
         // CSVとログファイルの保存
         std::string csv_filename = "elnino_simulation.csv";
         model.save_to_csv(csv_filename);
-        
+
         std::string log_filename = "elnino_log.txt";
         model.save_log(log_filename);
-        
+
         std::cout << "Simulation completed successfully. Data saved to " << csv_filename << " and logs saved to " << log_filename << "." << std::endl;
 
     } catch (const std::exception &e) {
@@ -0,0 +1,91 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+
+// 帧时间统计：每 reportEvery 帧打印一次帧间隔与渲染耗时（平均 / 最小 / 95 分位 / 最大）
+// 以及同期的模拟步数，用于比较不同渲染路径（例如 llvmpipe 下）的性能
+class FrameStats {
+public:
+    explicit FrameStats(const std::string& label, std::size_t reportEvery = 240)
+        : label(label), reportEvery(reportEvery), simulationSteps(0), started(false) {
+        intervals.reserve(reportEvery);
+        renderTimes.reserve(reportEvery);
+    }
+
+    // 在提交绘制命令前调用
+    void beginFrame() {
+        renderStart = Clock::now();
+    }
+
+    // 在 SwapBuffers 之后调用
+    void endFrame() {
+        const Clock::time_point now = Clock::now();
+        renderTimes.push_back(milliseconds(renderStart, now));
+        if (started) {
+            intervals.push_back(milliseconds(lastFrame, now));
+        } else {
+            started = true;
+            windowStart = now;
+        }
+        lastFrame = now;
+
+        if (renderTimes.size() >= reportEvery) {
+            report(now);
+        }
+    }
+
+    void addSimulationSteps(std::size_t steps) { simulationSteps += steps; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string label;
+    std::size_t reportEvery;
+    std::size_t simulationSteps;
+    bool started;
+    Clock::time_point renderStart, lastFrame, windowStart;
+    std::vector<double> intervals;
+    std::vector<double> renderTimes;
+
+    static double milliseconds(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    static void summarize(std::vector<double>& samples, double& mean, double& low, double& p95, double& high) {
+        mean = low = p95 = high = 0.0;
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        for (double value : samples) mean += value;
+        mean /= samples.size();
+        low = samples.front();
+        high = samples.back();
+        p95 = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+    }
+
+    void report(Clock::time_point now) {
+        double frameMean, frameMin, frameP95, frameMax;
+        double renderMean, renderMin, renderP95, renderMax;
+        summarize(intervals, frameMean, frameMin, frameP95, frameMax);
+        summarize(renderTimes, renderMean, renderMin, renderP95, renderMax);
+        const double seconds = milliseconds(windowStart, now) / 1000.0;
+
+        std::cerr << "[" << label << "] " << renderTimes.size() << " frames: frame "
+                  << frameMean << " ms mean (min " << frameMin << ", p95 " << frameP95 << ", max " << frameMax << "), render "
+                  << renderMean << " ms mean (p95 " << renderP95 << ", max " << renderMax << "), "
+                  << (frameMean > 0.0 ? 1000.0 / frameMean : 0.0) << " fps, "
+                  << (seconds > 0.0 ? simulationSteps / seconds : 0.0) << " sim steps/s" << std::endl;
+
+        intervals.clear();
+        renderTimes.clear();
+        simulationSteps = 0;
+        windowStart = now;
+    }
+};
+
+#endif
@@ -3,6 +3,8 @@
 #include <stdexcept>
 #include <vector>
 #include <string>
+#include <memory>
+#include "TimeSeriesSink.h"
 
 class Helium3Fusion {
 public:
@@ -10,6 +12,12 @@ public:
         if (reactantCount < 2) {
             throw std::invalid_argument("需要至少两个氦-3反应物。");
         }
+        // 与原来一样追加到 fusion_data.csv 且不写表头，但文件只打开一次；每次迭代只有一行，直接同步写入
+        SinkOptions options;
+        options.append = true;
+        options.header = false;
+        options.threaded = false;
+        csvSink.reset(new TimeSeriesSink("fusion_data.csv", {"reactants", "energy"}, options));
     }
 
     void performFusionIterations(int iterations) {
@@ -17,10 +25,12 @@ public:
             double energyReleased = performFusion();
             logToCSV(reactantCount, energyReleased);
         }
+        csvSink->flush();
     }
 
 private:
     int reactantCount;
+    std::unique_ptr<TimeSeriesSink> csvSink;
 
     double performFusion() {
         double energyReleased = 12.860; // 能量释放 (MeV)
@@ -34,12 +44,7 @@ private:
     }
 
     void logToCSV(int reactants, double energy) {
-        std::ofstream outFile("fusion_data.csv", std::ios::app);
-        if (!outFile) {
-            throw std::runtime_error("无法打开CSV文件。");
-        }
-        outFile << reactants << "," << energy << "\n";
-        outFile.close();
+        csvSink->append({static_cast<double>(reactants), energy});
     }
 };
 
@@ -1,11 +1,18 @@
 #include <iostream>
+// 定义 IA_SUPERNOVA_HEADLESS 编译时不依赖 OpenGL/GLFW，只保留离屏导出
+#ifndef IA_SUPERNOVA_HEADLESS
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#endif
 #include <vector>
+#include <string>
 #include <cmath>
+#include "OffscreenExport.h"
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
+const int CURVE_DURATION = 100;     // 光度曲线的时间范围
+const float PEAK_LUMINOSITY = 5.0f;
 
 class WhiteDwarf {
 public:
@@ -18,7 +25,7 @@ private:
 
 class IaSupernova {
 public:
-    IaSupernova(WhiteDwarf* star1, WhiteDwarf* star2) {
+    IaSupernova(WhiteDwarf* star1, WhiteDwarf* star2) : exploded(false) {
         totalMass = star1->getMass() + star2->getMass();
         if (totalMass > 1.4f) { // 钱德拉塞卡极限
             explode();
@@ -28,23 +35,78 @@ public:
     }
 
     void explode() {
+        exploded = true;
         std::cout << "Ia Supernova explosion initiated!" << std::endl;
         luminosityCurve();
     }
 
     void luminosityCurve() {
         std::cout << "Simulating luminosity curve:" << std::endl;
-        for (int t = 0; t <= 100; t += 10) {
-            float luminosity = 5 * exp(-0.03 * t); // 简化的光度曲线
-            std::cout << "Time: " << t << ", Luminosity: " << luminosity << std::endl;
+        for (int t = 0; t <= CURVE_DURATION; t += 10) {
+            std::cout << "Time: " << t << ", Luminosity: " << luminosityAt(t) << std::endl;
+        }
+    }
+
+    float luminosityAt(float t) const {
+        return exploded ? PEAK_LUMINOSITY * std::exp(-0.03f * t) : 0.0f; // 简化的光度曲线
+    }
+
+    // 离屏绘制：坐标轴及 [0, upTo] 区间内的光度曲线
+    void renderCurve(SoftwareFramebuffer& frame, float upTo) const {
+        const int margin = 40;
+        const int plotW = frame.getWidth() - 2 * margin;
+        const int plotH = frame.getHeight() - 2 * margin;
+        frame.clear(0.0f, 0.0f, 0.0f);
+        frame.drawLine(margin, margin, margin + plotW, margin, 0.6f, 0.6f, 0.6f);
+        frame.drawLine(margin, margin, margin, margin + plotH, 0.6f, 0.6f, 0.6f);
+
+        int lastX = margin;
+        int lastY = margin + static_cast<int>(luminosityAt(0.0f) / PEAK_LUMINOSITY * plotH);
+        for (int x = 1; x <= plotW; ++x) {
+            const float t = static_cast<float>(x) / plotW * CURVE_DURATION;
+            if (t > upTo) break;
+            const int y = margin + static_cast<int>(luminosityAt(t) / PEAK_LUMINOSITY * plotH);
+            frame.drawLine(lastX, lastY, margin + x, y, 1.0f, 0.8f, 0.2f);
+            lastX = margin + x;
+            lastY = y;
         }
     }
 
 private:
     float totalMass; // 总质量
+    bool exploded;
 };
 
-int main() {
+// 无窗口模式：逐帧画出光度曲线的演化，由后台线程写出 PPM 序列
+int runOffscreen(IaSupernova& supernova, const std::string& prefix) {
+    SoftwareFramebuffer frame(WIDTH, HEIGHT);
+    FrameExporter exporter(prefix);
+    for (int t = 0; t <= CURVE_DURATION; ++t) {
+        supernova.renderCurve(frame, static_cast<float>(t));
+        exporter.submit(frame);
+    }
+    exporter.finish();
+    std::cout << exporter.framesSubmitted() << " frames written to " << prefix << "_*.ppm" << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--offscreen") {
+        WhiteDwarf dwarf1(0.7f);
+        WhiteDwarf dwarf2(0.8f);
+        IaSupernova supernova(&dwarf1, &dwarf2);
+        try {
+            return runOffscreen(supernova, argc > 2 ? argv[2] : "ia_supernova");
+        } catch (const std::exception& e) {
+            std::cerr << "Offscreen export failed: " << e.what() << std::endl;
+            return -1;
+        }
+    }
+
+#ifdef IA_SUPERNOVA_HEADLESS
+    std::cerr << "Usage: " << argv[0] << " --offscreen [PREFIX]" << std::endl;
+    return -1;
+#else
     // 初始化GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -86,4 +148,5 @@ int main() {
     delete supernova;
     glfwTerminate();
     return 0;
+#endif
 }
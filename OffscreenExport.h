@@ -0,0 +1,216 @@
+#ifndef OFFSCREEN_EXPORT_H
+#define OFFSCREEN_EXPORT_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+// 纯 CPU 的 RGB8 帧缓冲区，坐标原点在左下角（与 OpenGL 一致），不需要窗口或 GL 上下文
+class SoftwareFramebuffer {
+public:
+    SoftwareFramebuffer(int width = 0, int height = 0) { resize(width, height); }
+
+    void resize(int newWidth, int newHeight) {
+        width = newWidth;
+        height = newHeight;
+        pixels.assign(static_cast<std::size_t>(width) * height * 3, 0);
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const unsigned char* data() const { return pixels.data(); }
+    unsigned char* data() { return pixels.data(); }
+    std::size_t bytes() const { return pixels.size(); }
+
+    void clear(float r, float g, float b) {
+        const unsigned char color[3] = {toByte(r), toByte(g), toByte(b)};
+        for (std::size_t k = 0; k < pixels.size(); k += 3) {
+            pixels[k] = color[0];
+            pixels[k + 1] = color[1];
+            pixels[k + 2] = color[2];
+        }
+    }
+
+    void setPixel(int x, int y, float r, float g, float b) {
+        if (x < 0 || y < 0 || x >= width || y >= height) return;
+        unsigned char* pixel = &pixels[(static_cast<std::size_t>(height - 1 - y) * width + x) * 3];
+        pixel[0] = toByte(r);
+        pixel[1] = toByte(g);
+        pixel[2] = toByte(b);
+    }
+
+    // 以 (x, y) 为中心、边长为 size 的方点，对应 glPointSize
+    void drawPoint(float x, float y, int size, float r, float g, float b) {
+        const int x0 = static_cast<int>(std::floor(x - size * 0.5f + 0.5f));
+        const int y0 = static_cast<int>(std::floor(y - size * 0.5f + 0.5f));
+        fillRect(x0, y0, size, size, r, g, b);
+    }
+
+    void fillRect(int x, int y, int w, int h, float r, float g, float b) {
+        for (int yy = std::max(y, 0); yy < std::min(y + h, height); ++yy) {
+            for (int xx = std::max(x, 0); xx < std::min(x + w, width); ++xx) setPixel(xx, yy, r, g, b);
+        }
+    }
+
+    void drawLine(int x0, int y0, int x1, int y1, float r, float g, float b) {
+        const int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        const int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int error = dx + dy;
+        for (;;) {
+            setPixel(x0, y0, r, g, b);
+            if (x0 == x1 && y0 == y1) break;
+            const int e2 = 2 * error;
+            if (e2 >= dy) { error += dy; x0 += sx; }
+            if (e2 <= dx) { error += dx; y0 += sy; }
+        }
+    }
+
+    // 把 RGBA8 图像（首行在下）按最近邻缩放铺满整个帧
+    void blitRGBA(const unsigned char* rgba, int imageWidth, int imageHeight) {
+        for (int y = 0; y < height; ++y) {
+            const int sy = static_cast<int>(static_cast<long long>(y) * imageHeight / height);
+            unsigned char* row = &pixels[static_cast<std::size_t>(height - 1 - y) * width * 3];
+            for (int x = 0; x < width; ++x) {
+                const int sx = static_cast<int>(static_cast<long long>(x) * imageWidth / width);
+                const unsigned char* source = rgba + (static_cast<std::size_t>(sy) * imageWidth + sx) * 4;
+                row[3 * x] = source[0];
+                row[3 * x + 1] = source[1];
+                row[3 * x + 2] = source[2];
+            }
+        }
+    }
+
+private:
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // 首行在上，便于直接写入图像文件
+
+    static unsigned char toByte(float value) {
+        return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+};
+
+// 在后台线程把帧编码为 PPM（P6）图像序列 prefix_000000.ppm, prefix_000001.ppm, ...
+// submit 只交换缓冲区；编码线程落后时 submit 等待空闲缓冲区，因此不会丢帧。
+class FrameExporter {
+public:
+    explicit FrameExporter(const std::string& prefix, unsigned buffers = 3)
+        : prefix(prefix), frameIndex(0), stopping(false), failed(false) {
+        for (unsigned b = 0; b < std::max(1u, buffers); ++b) {
+            idle.push_back(SoftwareFramebuffer());
+        }
+        worker = std::thread(&FrameExporter::encoderLoop, this);
+    }
+
+    ~FrameExporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    // 提交一帧；frame 与一块空闲缓冲区交换内容，调用后 frame 可立即用于绘制下一帧
+    void submit(SoftwareFramebuffer& frame) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !idle.empty(); });
+        if (failed) throw std::runtime_error("Frame export failed: " + error);
+
+        SoftwareFramebuffer buffer;
+        std::swap(buffer, idle.back());
+        idle.pop_back();
+        std::swap(buffer, frame);
+        if (frame.getWidth() != buffer.getWidth() || frame.getHeight() != buffer.getHeight()) {
+            frame.resize(buffer.getWidth(), buffer.getHeight());
+        }
+        pending.push_back(Pending{frameIndex++, std::move(buffer)});
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    // 等待所有已提交的帧写完
+    void finish() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return pending.empty() && !encoding; });
+        if (failed) throw std::runtime_error("Frame export failed: " + error);
+    }
+
+    unsigned long framesSubmitted() const { return frameIndex; }
+
+private:
+    struct Pending {
+        unsigned long index;
+        SoftwareFramebuffer frame;
+    };
+
+    std::string prefix;
+    unsigned long frameIndex;
+    std::vector<SoftwareFramebuffer> idle;
+    std::deque<Pending> pending;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread worker;
+    bool stopping;
+    bool encoding = false;
+    bool failed;
+    std::string error;
+
+    void encoderLoop() {
+        for (;;) {
+            Pending job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (pending.empty()) return;
+                job = std::move(pending.front());
+                pending.pop_front();
+                encoding = true;
+            }
+
+            std::string message;
+            try {
+                writePPM(job);
+            } catch (const std::exception& e) {
+                message = e.what();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!message.empty() && !failed) {
+                    failed = true;
+                    error = message;
+                }
+                idle.push_back(std::move(job.frame));
+                encoding = false;
+            }
+            changed.notify_all();
+        }
+    }
+
+    void writePPM(const Pending& job) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "_%06lu.ppm", job.index);
+        const std::string filename = prefix + suffix;
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) throw std::runtime_error("cannot open " + filename);
+        file << "P6\n" << job.frame.getWidth() << " " << job.frame.getHeight() << "\n255\n";
+        file.write(reinterpret_cast<const char*>(job.frame.data()), job.frame.bytes());
+        if (!file) throw std::runtime_error("cannot write " + filename);
+    }
+};
+
+#endif
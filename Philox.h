@@ -0,0 +1,191 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+#include <cmath>
+
+// Philox4x32-10 计数器随机数生成器（Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"）。
+// 输出只取决于 (seed, counter)，没有共享状态：每个线程 / 每个粒子 / 每个网格单元按自己的
+// 计数器取数即可，结果与线程数和执行顺序无关。
+class Philox4x32 {
+public:
+    // 对一个 128 位计数器做 10 轮变换，得到 4 个 32 位随机数
+    static void generate(const std::uint32_t counter[4], std::uint64_t seed, std::uint32_t out[4]) {
+        std::uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+        std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+        std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            const std::uint64_t p0 = static_cast<std::uint64_t>(MULTIPLIER_0) * c0;
+            const std::uint64_t p1 = static_cast<std::uint64_t>(MULTIPLIER_1) * c2;
+            const std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            const std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c1 = static_cast<std::uint32_t>(p1);
+            c3 = static_cast<std::uint32_t>(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += WEYL_0;
+            k1 += WEYL_1;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    // 取高 24 位映射到 [0, 1)
+    static float toUniform(std::uint32_t bits) {
+        return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    static const std::uint32_t MULTIPLIER_0 = 0xD2511F53u;
+    static const std::uint32_t MULTIPLIER_1 = 0xCD9E8D57u;
+    static const std::uint32_t WEYL_0 = 0x9E3779B9u;
+    static const std::uint32_t WEYL_1 = 0xBB67AE85u;
+};
+
+// 顺序取数的包装：stream（例如时间步）与 substream（例如粒子或单元编号）确定一条独立序列，
+// 序列内部按块递增计数器，每块产出 4 个数
+class PhiloxRNG {
+public:
+    PhiloxRNG(std::uint64_t seed, std::uint64_t stream, std::uint32_t substream = 0)
+        : seed(seed), used(4) {
+        counter[0] = 0;
+        counter[1] = substream;
+        counter[2] = static_cast<std::uint32_t>(stream);
+        counter[3] = static_cast<std::uint32_t>(stream >> 32);
+    }
+
+    std::uint32_t nextUInt() {
+        if (used == 4) {
+            Philox4x32::generate(counter, seed, block);
+            ++counter[0];
+            used = 0;
+        }
+        return block[used++];
+    }
+
+    float uniform() { return Philox4x32::toUniform(nextUInt()); }
+
+    // 53 位精度的 (0, 1) 均匀数，用于需要取对数的采样算法
+    double uniformDouble() {
+        const std::uint64_t high = nextUInt() >> 5; // 27 位
+        const std::uint64_t low = nextUInt() >> 6;  // 26 位
+        return (static_cast<double>((high << 26) | low) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    // 二项分布 B(n, p)：n·p 较小时逐项反演，否则用 Hörmann 的 BTRS 拒绝采样，
+    // 期望代价与 n 无关，一个单元里无论有多少个体都只需一次采样
+    std::uint32_t binomial(std::uint32_t n, double p) {
+        if (n == 0 || p <= 0.0) return 0;
+        if (p >= 1.0) return n;
+        if (p > 0.5) return n - binomial(n, 1.0 - p);
+        if (n * p < 10.0) return binomialInversion(n, p);
+        return binomialBTRS(n, p);
+    }
+
+    // 泊松分布 P(mean)：均值较小时逐项反演，否则用 Hörmann 的 PTRS 拒绝采样
+    std::uint64_t poisson(double mean) {
+        if (mean <= 0.0) return 0;
+        if (mean < 10.0) return poissonInversion(mean);
+        return poissonPTRS(mean);
+    }
+
+private:
+    std::uint64_t seed;
+    std::uint32_t counter[4];
+    std::uint32_t block[4];
+    int used;
+
+    std::uint32_t binomialInversion(std::uint32_t n, double p) {
+        const double q = 1.0 - p;
+        const double s = p / q;
+        const double a = (n + 1) * s;
+        double r = std::pow(q, static_cast<double>(n));
+        double u = uniformDouble();
+        std::uint32_t k = 0;
+        while (u > r) {
+            u -= r;
+            ++k;
+            if (k > n) return n; // 仅在舍入误差累积时发生
+            r *= a / k - s;
+        }
+        return k;
+    }
+
+    std::uint64_t poissonInversion(double mean) {
+        double probability = std::exp(-mean);
+        double cumulative = probability;
+        const double u = uniformDouble();
+        std::uint64_t k = 0;
+        while (u > cumulative && probability > 0.0) {
+            ++k;
+            probability *= mean / k;
+            cumulative += probability;
+        }
+        return k;
+    }
+
+    // W. Hörmann, "The transformed rejection method for generating Poisson random variables" (1993)
+    std::uint64_t poissonPTRS(double mean) {
+        const double sqrtMean = std::sqrt(mean);
+        const double logMean = std::log(mean);
+        const double b = 0.931 + 2.53 * sqrtMean;
+        const double a = -0.059 + 0.02483 * b;
+        const double inverseAlpha = 1.1239 + 1.1328 / (b - 3.4);
+        const double vr = 0.9277 - 3.6224 / (b - 2);
+        for (;;) {
+            const double u = uniformDouble() - 0.5;
+            const double v = uniformDouble();
+            const double us = 0.5 - std::fabs(u);
+            const double k = std::floor((2 * a / us + b) * u + mean + 0.43);
+            if (us >= 0.07 && v <= vr) return static_cast<std::uint64_t>(k);
+            if (k < 0 || (us < 0.013 && v > us)) continue;
+            if (std::log(v) + std::log(inverseAlpha) - std::log(a / (us * us) + b) <=
+                -mean + k * logMean - std::lgamma(k + 1)) {
+                return static_cast<std::uint64_t>(k);
+            }
+        }
+    }
+
+    // log(k!) 的 Stirling 近似余项
+    static double stirlingTail(double k) {
+        static const double TAIL[10] = {
+            0.0810614667953272, 0.0413406959554092, 0.0276779256849983, 0.02079067210376509,
+            0.0166446911898211, 0.0138761288230707, 0.0118967099458917, 0.0104112652619720,
+            0.00925546218271273, 0.00833056343336287};
+        if (k <= 9) return TAIL[static_cast<int>(k)];
+        const double kp1sq = (k + 1) * (k + 1);
+        return (1.0 / 12 - (1.0 / 360 - 1.0 / 1260 / kp1sq) / kp1sq) / (k + 1);
+    }
+
+    // W. Hörmann, "The generation of binomial random variates" (1993)，要求 p <= 0.5 且 n·p >= 10
+    std::uint32_t binomialBTRS(std::uint32_t n, double p) {
+        const double q = 1.0 - p;
+        const double spq = std::sqrt(n * p * q);
+        const double b = 1.15 + 2.53 * spq;
+        const double a = -0.0873 + 0.0248 * b + 0.01 * p;
+        const double c = n * p + 0.5;
+        const double vr = 0.92 - 4.2 / b;
+        const double r = p / q;
+        const double alpha = (2.83 + 5.1 / b) * spq;
+        const double m = std::floor((n + 1) * p);
+        for (;;) {
+            const double u = uniformDouble() - 0.5;
+            double v = uniformDouble();
+            const double us = 0.5 - std::fabs(u);
+            const double k = std::floor((2 * a / us + b) * u + c);
+            if (k < 0 || k > n) continue;
+            if (us >= 0.07 && v <= vr) return static_cast<std::uint32_t>(k);
+
+            v = std::log(v * alpha / (a / (us * us) + b));
+            const double bound = (m + 0.5) * std::log((m + 1) / (r * (n - m + 1))) +
+                                 (n + 1) * std::log((n - m + 1) / (n - k + 1)) +
+                                 (k + 0.5) * std::log(r * (n - k + 1) / (k + 1)) +
+                                 stirlingTail(m) + stirlingTail(n - m) - stirlingTail(k) - stirlingTail(n - k);
+            if (v <= bound) return static_cast<std::uint32_t>(k);
+        }
+    }
+};
+
+#endif
@@ -1,75 +1,628 @@
 #include <iostream>
+// 定义 SUPERNOVA_HEADLESS 编译时不依赖 OpenGL/GLFW/GLUI，只保留离屏导出与基准测试
+#ifndef SUPERNOVA_HEADLESS
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <GL/glui.h>
+#endif
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include "ThreadPool.h"
+#include "Philox.h"
+#include "FrameStats.h"
+#include "OffscreenExport.h"
 
 const unsigned int WIDTH = 800;
 const unsigned int HEIGHT = 600;
+const float SIM_TIME_STEP = 1.0f / 120.0f; // 固定的模拟步长，与渲染帧率无关
+const float MAX_FRAME_TIME = 0.25f;        // 单帧最多追赶的模拟时间
+const float FIELD_OF_VIEW = 45.0f;         // 与 gluPerspective 的参数一致
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const float OFFSCREEN_FRAME_TIME = 1.0f / 60.0f;
+const std::size_t PARTICLE_CHUNK = 16384;          // 并行更新 / 排序的块大小（与线程数无关）
+const int MAX_PARTICLES = 4000000;                 // 交互模式下粒子池的容量，也是界面上限
+const int INITIAL_PARTICLES = 500;
+const int BURST_PARTICLES = 20000;                 // 界面上 Burst 按钮一次发射的粒子数
+const float PARTICLE_LIFESPAN = 1.0f;              // 新粒子的寿命在 [0, PARTICLE_LIFESPAN) 内均匀分布
+const std::uint64_t PARTICLE_SEED = 0x5EED5EEDull; // 默认随机种子
+const std::uint32_t JITTER_BLOCK = 0;              // Philox 计数器首字：区分扰动（按时间步）与发射（按发射批次）
+const std::uint32_t EMIT_BLOCK = 1;
+const float EMIT_RADIUS = 0.2f;                    // 新粒子在以原点为中心的立方体内生成
+const float BLAST_SPEED = 4.0f;                    // 发射区边缘处的初始径向速度
+const float INTERACTION_RADIUS = 0.25f;            // 短程压力的作用半径，也是空间哈希的单元边长
+const float PRESSURE_STIFFNESS = 60.0f;
+const std::uint32_t BUCKET_SAMPLES = 2;            // 每个邻居桶最多取样的粒子数，限制稠密区域的代价
+const float NOISE_ACCELERATION = 30.0f;            // 随机热扰动的加速度幅度
+const std::size_t BENCH_PARTICLES = 10000000;
+const int BENCH_STEPS = 60;
 
-// 粒子结构
-struct Particle {
-    float position[3];
-    float lifespan;
+// 结构数组（SoA）形式的粒子存储：位置、速度分量与寿命各占一段连续内存
+struct ParticleArrays {
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> lifespan;
+
+    void resize(std::size_t count) {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        vx.resize(count);
+        vy.resize(count);
+        vz.resize(count);
+        lifespan.resize(count);
+    }
+
+    void swap(ParticleArrays& other) {
+        x.swap(other.x);
+        y.swap(other.y);
+        z.swap(other.z);
+        vx.swap(other.vx);
+        vy.swap(other.vy);
+        vz.swap(other.vz);
+        lifespan.swap(other.lifespan);
+    }
 };
 
-// 粒子系统
+struct alignas(16) PackedPosition {
+    float x, y, z, pad;
+};
+
+// 均匀网格空间哈希。每步用并行计数排序把粒子按哈希桶重新排列：同一单元的粒子在内存中相邻，
+// 邻居查询只需扫描 27 个单元对应的连续区间。死亡粒子被排到最后一个桶并直接丢弃，
+// 因此这次排序同时完成了压缩。排序按固定数目的块进行，结果与线程数无关。
+class SpatialHash {
+public:
+    SpatialHash(float cellSize, std::size_t capacity)
+        : cellSize(cellSize), inverseCellSize(1.0f / cellSize), bucketCount(MIN_BUCKETS) {
+        maxBuckets = MIN_BUCKETS;
+        while (maxBuckets < capacity && maxBuckets < MAX_BUCKETS) maxBuckets <<= 1;
+        keys.resize(capacity);
+        positions.resize(capacity);
+        // 块数与桶数都不超过容量对应的值，直方图按两者的乘积分配
+        histograms.resize(blocksFor(capacity) * (maxBuckets + 1));
+        bucketStart.resize(maxBuckets + 2, 0);
+    }
+
+    // 把 from 中 [0, count) 的存活粒子按桶顺序稳定地写入 to，返回存活数
+    std::size_t rebuild(ThreadPool& pool, const ParticleArrays& from, std::size_t count, ParticleArrays& to) {
+        bucketCount = MIN_BUCKETS;
+        while (bucketCount < count && bucketCount < maxBuckets) bucketCount <<= 1;
+        const std::size_t dead = bucketCount;       // 死亡粒子所在的额外桶
+        const std::size_t buckets = bucketCount + 1;
+        const std::size_t blocks = blocksFor(count);
+        const std::size_t blockSize = (count + blocks - 1) / blocks;
+
+        // 1. 每块计算桶号并统计直方图。直方图按 [桶][块] 排列，之后按桶的两次遍历都是连续访问
+        pool.parallelFor(0, buckets, BUCKET_GRAIN, [&](std::size_t first, std::size_t last) {
+            std::fill(histograms.begin() + first * blocks, histograms.begin() + last * blocks, 0u);
+        });
+        pool.parallelFor(0, blocks, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t block = first; block < last; ++block) {
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; ++i) {
+                    const std::uint32_t key = from.lifespan[i] > 0
+                        ? bucketOf(from.x[i], from.y[i], from.z[i])
+                        : static_cast<std::uint32_t>(dead);
+                    keys[i] = key;
+                    ++histograms[key * blocks + block];
+                }
+            }
+        });
+
+        // 2. 每个桶的总数做前缀和得到桶起点，再把各块的计数换成该块在桶内的写入位置
+        pool.parallelFor(0, buckets, BUCKET_GRAIN, [&](std::size_t first, std::size_t last) {
+            for (std::size_t b = first; b < last; ++b) {
+                std::uint32_t total = 0;
+                for (std::size_t block = 0; block < blocks; ++block) total += histograms[b * blocks + block];
+                bucketStart[b] = total;
+            }
+        });
+        std::uint32_t running = 0;
+        for (std::size_t b = 0; b < buckets; ++b) {
+            const std::uint32_t total = bucketStart[b];
+            bucketStart[b] = running;
+            running += total;
+        }
+        bucketStart[buckets] = running;
+        pool.parallelFor(0, buckets, BUCKET_GRAIN, [&](std::size_t first, std::size_t last) {
+            for (std::size_t b = first; b < last; ++b) {
+                std::uint32_t offset = bucketStart[b];
+                for (std::size_t block = 0; block < blocks; ++block) {
+                    std::uint32_t& slot = histograms[b * blocks + block];
+                    const std::uint32_t n = slot;
+                    slot = offset;
+                    offset += n;
+                }
+            }
+        });
+
+        // 3. 每块按原顺序把存活粒子散射到目标位置
+        pool.parallelFor(0, blocks, 1, [&](std::size_t first, std::size_t last) {
+            for (std::size_t block = first; block < last; ++block) {
+                const std::size_t end = std::min(count, (block + 1) * blockSize);
+                for (std::size_t i = block * blockSize; i < end; ++i) {
+                    const std::uint32_t key = keys[i];
+                    if (key == dead) continue;
+                    const std::uint32_t out = histograms[key * blocks + block]++;
+                    to.x[out] = from.x[i];
+                    to.y[out] = from.y[i];
+                    to.z[out] = from.z[i];
+                    to.vx[out] = from.vx[i];
+                    to.vy[out] = from.vy[i];
+                    to.vz[out] = from.vz[i];
+                    to.lifespan[out] = from.lifespan[i];
+                    positions[out] = {from.x[i], from.y[i], from.z[i], 0.0f};
+                }
+            }
+        });
+        return bucketStart[dead];
+    }
+
+    // 单元 (cx, cy, cz) 周围 27 个单元中非空的桶写入 buckets，返回桶数。
+    // 不同单元可能落入同一个桶，每个桶只出现一次，因此每对粒子恰好被对方各看到一次
+    int neighborBuckets(int cx, int cy, int cz, std::uint32_t buckets[27]) const {
+        int bucketCount = 0;
+        for (int ox = -1; ox <= 1; ++ox) {
+            for (int oy = -1; oy <= 1; ++oy) {
+                for (int oz = -1; oz <= 1; ++oz) {
+                    const std::uint32_t key = hashCell(cx + ox, cy + oy, cz + oz);
+                    if (bucketStart[key] == bucketStart[key + 1]) continue;
+                    if (std::find(buckets, buckets + bucketCount, key) != buckets + bucketCount) continue;
+                    buckets[bucketCount++] = key;
+                }
+            }
+        }
+        return bucketCount;
+    }
+
+    std::uint32_t bucketBegin(std::uint32_t key) const { return bucketStart[key]; }
+    std::uint32_t bucketEnd(std::uint32_t key) const { return bucketStart[key + 1]; }
+    std::uint32_t bucketAt(float x, float y, float z) const { return bucketOf(x, y, z); }
+    const PackedPosition* packedPositions() const { return positions.data(); }
+
+    int cellOf(float coordinate) const {
+        return static_cast<int>(std::floor(coordinate * inverseCellSize));
+    }
+
+    float getCellSize() const { return cellSize; }
+
+private:
+    static const std::size_t MIN_BUCKETS = 1024;
+    static const std::size_t MAX_BUCKETS = 1 << 18;
+    static const std::size_t SORT_BLOCKS = 64;
+    static const std::size_t BUCKET_GRAIN = 4096;
+
+    float cellSize;
+    float inverseCellSize;
+    std::size_t bucketCount;
+    std::size_t maxBuckets;
+    std::vector<std::uint32_t> keys;         // 每个粒子的桶号
+    std::vector<PackedPosition> positions;   // 排序后位置的交错副本，邻居扫描每个粒子只读一条缓存行
+    std::vector<std::uint32_t> histograms;   // [桶][块] 的计数，随后变为写入位置
+    std::vector<std::uint32_t> bucketStart;  // 排序后每个桶的起始下标
+
+    static std::size_t blocksFor(std::size_t count) {
+        return std::max<std::size_t>(1, std::min(SORT_BLOCKS, (count + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK));
+    }
+
+    // Teschner et al. 2003 的空间哈希
+    std::uint32_t hashCell(int cx, int cy, int cz) const {
+        return ((static_cast<std::uint32_t>(cx) * 73856093u) ^
+                (static_cast<std::uint32_t>(cy) * 19349663u) ^
+                (static_cast<std::uint32_t>(cz) * 83492791u)) & static_cast<std::uint32_t>(bucketCount - 1);
+    }
+
+    std::uint32_t bucketOf(float x, float y, float z) const {
+        return hashCell(cellOf(x), cellOf(y), cellOf(z));
+    }
+};
+
+// 粒子系统。所有数组在构造时按固定容量一次分配，之后不再重新分配。
+// 每步先由邻近粒子间的短程压力和随机热扰动更新速度，再积分位置；
+// 之后空间哈希的计数排序把存活粒子按单元重新排列并压缩到 [0, aliveCount())，
+// 因此空闲槽位就是尾部的 [aliveCount(), capacity())，发射器直接在那里原地复用过期粒子。
+// 扰动的随机数由 Philox(seed, 时间步, 粒子下标) 给出，发射的随机数由 Philox(seed, 发射批次, 槽位下标) 给出，
+// 因此结果与线程数无关。构造时与第一步的发射同处时间步 0，用批次编号区分，复用的槽位不会重复取到同一组随机数。
 class Supernova {
 public:
-    Supernova(int particleCount);
+    Supernova(std::size_t capacity, std::size_t particleCount,
+              unsigned threads = std::thread::hardware_concurrency(), std::uint64_t seed = PARTICLE_SEED);
+    ~Supernova();
     void update(float deltaTime);
-    void render();
-    void setParticleCount(int count);
+#ifndef SUPERNOVA_HEADLESS
+    void render();          // 保留模式：存活粒子每帧一次性上传到 VBO 后单次绘制
+    void renderImmediate(); // 旧的逐粒子 glVertex3f 路径，用于对比
+#endif
+    void renderSoftware(SoftwareFramebuffer& frame) const; // 离屏：CPU 透视投影后画点
+    void setParticleCount(int count); // 存活粒子数的上限，超出的部分均匀地抽掉
+    void setSpawnRate(float particlesPerSecond) { spawnRate = std::max(particlesPerSecond, 0.0f); }
+    void burst(std::size_t particles) { pendingBurst += particles; } // 在下一次 update 中一次性发射
+
+    std::size_t aliveCount() const { return count; }
+    std::size_t capacity() const { return particles.lifespan.size(); }
+    unsigned threads() const { return pool.size(); }
+    const ParticleArrays& state() const { return particles; }
 
 private:
-    std::vector<Particle> particles;
-    int maxParticles;
+    ThreadPool pool;
+    std::uint64_t seed;
+    std::uint64_t stepIndex;
+    std::uint64_t emitIndex;         // 已经执行的发射批次数，作为发射随机数的计数器
+    ParticleArrays particles;
+    ParticleArrays scratch;          // 排序的目标缓冲区，与 particles 交替使用
+    SpatialHash grid;
+    std::size_t count;
+    std::size_t activeLimit;
+    float spawnRate;
+    float spawnDebt;                 // 按速率累积但尚未发射的粒子（小数部分）
+    std::size_t pendingBurst;
+    std::vector<std::size_t> chunkAlive; // 积分后每块仍存活的粒子数
+#ifndef SUPERNOVA_HEADLESS
+    std::vector<float> vertices;   // 每帧复用的上传缓冲区
+    GLuint vertexBuffer = 0;
+    std::size_t bufferBytes = 0;
+#endif
+
+    void accelerate(float deltaTime);
+    std::size_t integrate(float deltaTime);
+    void emit(std::size_t particles);
+    void rebuild();
 };
 
-Supernova::Supernova(int particleCount) : maxParticles(particleCount) {
-    particles.resize(maxParticles);
-    for (int i = 0; i < maxParticles; ++i) {
-        particles[i].position[0] = 0.0f;
-        particles[i].position[1] = 0.0f;
-        particles[i].position[2] = 0.0f;
-        particles[i].lifespan = static_cast<float>(rand() % 100) / 100.0f;
-    }
+Supernova::Supernova(std::size_t capacity, std::size_t particleCount, unsigned threads, std::uint64_t seed)
+    : pool(threads), seed(seed), stepIndex(0), emitIndex(0), grid(INTERACTION_RADIUS, capacity), count(0),
+      activeLimit(capacity), spawnRate(0.0f), spawnDebt(0.0f), pendingBurst(0) {
+    particles.resize(capacity);
+    scratch.resize(capacity);
+    chunkAlive.reserve(capacity / PARTICLE_CHUNK + 1);
+#ifndef SUPERNOVA_HEADLESS
+    vertices.reserve(capacity * 3);
+#endif
+    emit(std::min(particleCount, capacity));
+    rebuild();
+}
+
+// 在池尾部的空闲槽位 [count, count + particles) 原地初始化新粒子：
+// 位置在发射区内随机，速度沿径向向外，模拟爆炸初始的冲击
+void Supernova::emit(std::size_t particles) {
+    const std::size_t begin = count;
+    const std::uint64_t batch = emitIndex++;
+    ParticleArrays& p = this->particles;
+    pool.parallelFor(begin, begin + particles, PARTICLE_CHUNK, [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            const std::uint32_t counter[4] = {EMIT_BLOCK, static_cast<std::uint32_t>(i),
+                                              static_cast<std::uint32_t>(batch), static_cast<std::uint32_t>(batch >> 32)};
+            std::uint32_t bits[4];
+            Philox4x32::generate(counter, seed, bits);
+            p.lifespan[i] = Philox4x32::toUniform(bits[0]) * PARTICLE_LIFESPAN;
+            p.x[i] = (Philox4x32::toUniform(bits[1]) * 2.0f - 1.0f) * EMIT_RADIUS;
+            p.y[i] = (Philox4x32::toUniform(bits[2]) * 2.0f - 1.0f) * EMIT_RADIUS;
+            p.z[i] = (Philox4x32::toUniform(bits[3]) * 2.0f - 1.0f) * EMIT_RADIUS;
+            p.vx[i] = p.x[i] * (BLAST_SPEED / EMIT_RADIUS);
+            p.vy[i] = p.y[i] * (BLAST_SPEED / EMIT_RADIUS);
+            p.vz[i] = p.z[i] * (BLAST_SPEED / EMIT_RADIUS);
+        }
+    });
+    count += particles;
+}
+
+// 短程压力：半径内的邻居按 stiffness * (1 - r/h)^2 沿连线推开；另加随机热扰动。
+// 稠密区域的代价用对称的取样限制：粒子数为 n 的桶的步长为 ceil(n / BUCKET_SAMPLES)，
+// 桶 A 与桶 B 之间只计算下标之差是 max(步长A, 步长B) 倍数的粒子对，每个粒子在每个邻居桶中最多取 BUCKET_SAMPLES 个。
+// 每个取样的粒子对代表 步长 个粒子对，其力乘以步长，使稠密区域的压力总和保持无偏。
+// 这个条件和步长对 i、j 对称且与扫描顺序无关；交换两者时坐标差精确取反，因此 f(i, j) == -f(j, i)，
+// 动量守恒只受求和舍入影响。粒子已按桶排序，同一单元的连续粒子共用一次邻居桶查询。
+// 只读位置、只写本粒子的速度，因此可以按块并行
+void Supernova::accelerate(float deltaTime) {
+    const float radius = grid.getCellSize();
+    const float radiusSquared = radius * radius;
+    const std::uint64_t step = stepIndex;
+    ParticleArrays& p = particles;
+    const PackedPosition* sorted = grid.packedPositions();
+    pool.parallelFor(0, count, PARTICLE_CHUNK, [&](std::size_t begin, std::size_t end) {
+        // 当前单元的邻居桶：区间、步长，以及 (i - 起点) 对步长的余数（随 i 递增而更新，避免逐粒子做除法）
+        std::uint32_t buckets[27], first[27], last[27], stride[27], phase[27];
+        int bucketCount = 0;
+        int lastX = 0, lastY = 0, lastZ = 0;
+        std::size_t lastIndex = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            const float xi = p.x[i], yi = p.y[i], zi = p.z[i];
+            const int cx = grid.cellOf(xi), cy = grid.cellOf(yi), cz = grid.cellOf(zi);
+            const std::uint32_t index = static_cast<std::uint32_t>(i);
+            if (i == begin || cx != lastX || cy != lastY || cz != lastZ) {
+                bucketCount = grid.neighborBuckets(cx, cy, cz, buckets);
+                const std::uint32_t own = grid.bucketAt(xi, yi, zi);
+                const std::uint32_t ownSize = grid.bucketEnd(own) - grid.bucketBegin(own);
+                for (int b = 0; b < bucketCount; ++b) {
+                    first[b] = grid.bucketBegin(buckets[b]);
+                    last[b] = grid.bucketEnd(buckets[b]);
+                    stride[b] = (std::max(last[b] - first[b], ownSize) + BUCKET_SAMPLES - 1) / BUCKET_SAMPLES;
+                    phase[b] = stride[b] == 1 ? 0 : (index + stride[b] - first[b] % stride[b]) % stride[b];
+                }
+                lastX = cx;
+                lastY = cy;
+                lastZ = cz;
+            } else {
+                // 同一单元的下一个粒子：余数加上下标的增量（冲突桶中的其他单元可能夹在中间）
+                const std::uint32_t advance = static_cast<std::uint32_t>(i - lastIndex);
+                for (int b = 0; b < bucketCount; ++b) {
+                    if (stride[b] == 1) continue;
+                    phase[b] += advance;
+                    if (phase[b] >= stride[b]) phase[b] %= stride[b];
+                }
+            }
+            lastIndex = i;
+
+            float ax = 0.0f, ay = 0.0f, az = 0.0f;
+            for (int b = 0; b < bucketCount; ++b) {
+                const float stiffness = PRESSURE_STIFFNESS * static_cast<float>(stride[b]);
+                // 从桶内第一个与 i 对步长同余的下标开始
+                for (std::uint32_t j = first[b] + phase[b]; j < last[b]; j += stride[b]) {
+                    const float dx = xi - sorted[j].x, dy = yi - sorted[j].y, dz = zi - sorted[j].z;
+                    const float distanceSquared = dx * dx + dy * dy + dz * dz;
+                    if (distanceSquared >= radiusSquared || distanceSquared < 1e-12f) continue; // 也排除 j == i
+                    const float distance = std::sqrt(distanceSquared);
+                    const float weight = 1.0f - distance / radius;
+                    const float scale = stiffness * weight * weight / distance;
+                    ax += scale * dx;
+                    ay += scale * dy;
+                    az += scale * dz;
+                }
+            }
+
+            const std::uint32_t counter[4] = {JITTER_BLOCK, index,
+                                              static_cast<std::uint32_t>(step), static_cast<std::uint32_t>(step >> 32)};
+            std::uint32_t bits[4];
+            Philox4x32::generate(counter, seed, bits);
+            ax += (Philox4x32::toUniform(bits[0]) * 2.0f - 1.0f) * NOISE_ACCELERATION;
+            ay += (Philox4x32::toUniform(bits[1]) * 2.0f - 1.0f) * NOISE_ACCELERATION;
+            az += (Philox4x32::toUniform(bits[2]) * 2.0f - 1.0f) * NOISE_ACCELERATION;
+
+            p.vx[i] += ax * deltaTime;
+            p.vy[i] += ay * deltaTime;
+            p.vz[i] += az * deltaTime;
+        }
+    });
+}
+
+// 积分位置与寿命，返回仍存活的粒子数（逐块统计后求和，与线程数无关）
+std::size_t Supernova::integrate(float deltaTime) {
+    chunkAlive.assign((count + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK, 0);
+    ParticleArrays& p = particles;
+    pool.parallelFor(0, count, PARTICLE_CHUNK, [&](std::size_t begin, std::size_t end) {
+        std::size_t alive = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            p.x[i] += p.vx[i] * deltaTime;
+            p.y[i] += p.vy[i] * deltaTime;
+            p.z[i] += p.vz[i] * deltaTime;
+            p.lifespan[i] -= deltaTime;
+            alive += p.lifespan[i] > 0;
+        }
+        chunkAlive[begin / PARTICLE_CHUNK] = alive;
+    });
+
+    std::size_t alive = 0;
+    for (std::size_t chunk : chunkAlive) alive += chunk;
+    return alive;
+}
+
+// 空间哈希排序同时去掉死亡粒子，结果写入 scratch 后交换
+void Supernova::rebuild() {
+    count = grid.rebuild(pool, particles, count, scratch);
+    particles.swap(scratch);
 }
 
 void Supernova::update(float deltaTime) {
-    for (auto& particle : particles) {
-        particle.lifespan -= deltaTime;
-        if (particle.lifespan > 0) {
-            particle.position[0] += ((rand() % 200) - 100) / 100.0f;
-            particle.position[1] += ((rand() % 200) - 100) / 100.0f;
-            particle.position[2] += ((rand() % 200) - 100) / 100.0f;
+    accelerate(deltaTime);
+    const std::size_t alive = integrate(deltaTime);
+
+    // 先发射爆发的粒子，再按速率补充，存活总数不超过上限；新粒子写在尾部，随后与其余粒子一起排序
+    spawnDebt += spawnRate * deltaTime;
+    const std::size_t due = static_cast<std::size_t>(spawnDebt);
+    spawnDebt -= static_cast<float>(due);
+    const std::size_t room = std::min(activeLimit > alive ? activeLimit - alive : 0, capacity() - count);
+    emit(std::min(pendingBurst + due, room));
+    pendingBurst = 0;
+
+    rebuild();
+    ++stepIndex;
+}
+
+Supernova::~Supernova() {
+#ifndef SUPERNOVA_HEADLESS
+    if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+#endif
+}
+
+#ifndef SUPERNOVA_HEADLESS
+void Supernova::render() {
+    // 存活粒子已经紧凑排列，直接按块并行交织成 xyz 顶点（容量已在构造时预留）
+    vertices.resize(count * 3);
+    pool.parallelFor(0, count, PARTICLE_CHUNK, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            vertices[3 * i] = particles.x[i];
+            vertices[3 * i + 1] = particles.y[i];
+            vertices[3 * i + 2] = particles.z[i];
         }
+    });
+
+    if (!vertexBuffer) glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    const std::size_t bytes = vertices.size() * sizeof(float);
+    if (bufferBytes == 0) {
+        bufferBytes = capacity() * 3 * sizeof(float);
     }
+    // 先丢弃旧存储再写入，避免等待上一帧仍在使用的缓冲区
+    glBufferData(GL_ARRAY_BUFFER, bufferBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices.data());
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, nullptr);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void Supernova::render() {
+void Supernova::renderImmediate() {
     glBegin(GL_POINTS);
-    for (const auto& particle : particles) {
-        if (particle.lifespan > 0) {
-            glVertex3f(particle.position[0], particle.position[1], particle.position[2]);
-        }
+    for (std::size_t i = 0; i < count; ++i) {
+        glVertex3f(particles.x[i], particles.y[i], particles.z[i]);
     }
     glEnd();
 }
+#endif
 
-void Supernova::setParticleCount(int count) {
-    maxParticles = count;
-    particles.resize(maxParticles);
+void Supernova::renderSoftware(SoftwareFramebuffer& frame) const {
+    const float focal = 1.0f / std::tan(FIELD_OF_VIEW * 0.5f * 3.14159265f / 180.0f);
+    const float aspect = static_cast<float>(frame.getWidth()) / frame.getHeight();
+    frame.clear(0.0f, 0.0f, 0.0f);
+    for (std::size_t i = 0; i < count; ++i) {
+        const float depth = -particles.z[i]; // 相机位于原点、朝向 -z
+        if (depth < NEAR_PLANE || depth > FAR_PLANE) continue;
+        const float x = focal / aspect * particles.x[i] / depth;
+        const float y = focal * particles.y[i] / depth;
+        if (x < -1.0f || x > 1.0f || y < -1.0f || y > 1.0f) continue;
+        frame.drawPoint((x + 1.0f) * 0.5f * frame.getWidth(), (y + 1.0f) * 0.5f * frame.getHeight(), 2, 1.0f, 1.0f, 1.0f);
+    }
+}
+
+// 粒子按空间哈希桶排列，直接截断会删掉整片区域。改为在存活粒子中按下标等间隔地选出多余的粒子，
+// 把寿命置 0，下一次积分后它们即死亡并在重建时被移除，粒子云整体变稀。
+// 两次更新之间多次调用时，已被选中的粒子不再计入存活数
+void Supernova::setParticleCount(int newCount) {
+    activeLimit = std::min(static_cast<std::size_t>(std::max(newCount, 0)), capacity());
+    std::vector<float>& lifespan = particles.lifespan;
+    const std::size_t alive = std::count_if(lifespan.begin(), lifespan.begin() + count, [](float t) { return t > 0.0f; });
+    if (alive <= activeLimit) return;
+    const std::size_t excess = alive - activeLimit;
+    std::size_t rank = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (lifespan[i] <= 0.0f) continue;
+        // 第 rank 个存活粒子使 floor(rank * excess / alive) 增加时被选中，恰好选出 excess 个
+        if ((rank + 1) * excess / alive != rank * excess / alive) lifespan[i] = 0.0f;
+        ++rank;
+    }
 }
 
 Supernova* supernova;
 
-// 回调函数用于更新粒子数量
-void updateParticleCount(int newCount) {
-    supernova->setParticleCount(newCount);
+#ifndef SUPERNOVA_HEADLESS
+int particleCount = INITIAL_PARTICLES;
+float spawnRate = INITIAL_PARTICLES / (0.5f * PARTICLE_LIFESPAN); // 维持粒子数所需的平均发射率
+
+// GLUI 回调传入的是控件编号，数值从对应的实时变量读取；这些调用都不分配内存
+void updateParticleCount(int) {
+    supernova->setParticleCount(particleCount);
+}
+
+void updateSpawnRate(int) {
+    supernova->setSpawnRate(spawnRate);
+}
+
+void triggerBurst(int) {
+    supernova->burst(BURST_PARTICLES);
+}
+#endif
+
+// 吞吐量基准：线程数从 1 增加到 maxThreads，报告每秒更新的粒子数，并检查结果与单线程一致
+int runBenchmark(std::size_t particleCount, int steps, unsigned maxThreads) {
+    std::unique_ptr<Supernova> reference;
+    double baseSeconds = 0.0;
+    bool allIdentical = true;
+
+    std::cout << "threads,seconds,Mparticles_per_s,speedup,alive,identical" << std::endl;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        std::unique_ptr<Supernova> simulation(new Supernova(particleCount, particleCount, threads));
+        // 按平均寿命设定发射率，使粒子池保持接近满载，测得的是稳定状态下的吞吐量
+        simulation->setSpawnRate(particleCount / (0.5f * PARTICLE_LIFESPAN));
+        double particleSteps = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step) {
+            particleSteps += simulation->aliveCount();
+            simulation->update(SIM_TIME_STEP);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool identical = true;
+        if (!reference) {
+            baseSeconds = seconds;
+        } else {
+            const ParticleArrays& a = reference->state();
+            const ParticleArrays& b = simulation->state();
+            const std::size_t alive = simulation->aliveCount();
+            identical = alive == reference->aliveCount() &&
+                        std::equal(a.x.begin(), a.x.begin() + alive, b.x.begin()) &&
+                        std::equal(a.y.begin(), a.y.begin() + alive, b.y.begin()) &&
+                        std::equal(a.z.begin(), a.z.begin() + alive, b.z.begin()) &&
+                        std::equal(a.vx.begin(), a.vx.begin() + alive, b.vx.begin()) &&
+                        std::equal(a.lifespan.begin(), a.lifespan.begin() + alive, b.lifespan.begin());
+            allIdentical = allIdentical && identical;
+        }
+
+        std::cout << threads << "," << seconds << "," << particleSteps / seconds / 1e6 << ","
+                  << baseSeconds / seconds << "," << simulation->aliveCount() << ","
+                  << (identical ? "yes" : "NO") << std::endl;
+        if (!reference) reference = std::move(simulation);
+    }
+
+    if (!allIdentical) {
+        std::cerr << "Multithreaded result differs from single-threaded result" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 无窗口模式：固定步长模拟，每帧用软件光栅化并在后台线程写出 PPM 序列
+int runOffscreen(int frames, const std::string& prefix) {
+    supernova = new Supernova(INITIAL_PARTICLES, INITIAL_PARTICLES);
+    supernova->setSpawnRate(INITIAL_PARTICLES / (0.5f * PARTICLE_LIFESPAN));
+    SoftwareFramebuffer frame(WIDTH, HEIGHT);
+    FrameExporter exporter(prefix);
+
+    for (int f = 0; f < frames; ++f) {
+        for (float t = 0.0f; t + SIM_TIME_STEP <= OFFSCREEN_FRAME_TIME + 1e-6f; t += SIM_TIME_STEP) {
+            supernova->update(SIM_TIME_STEP);
+        }
+        supernova->renderSoftware(frame);
+        exporter.submit(frame);
+    }
+    exporter.finish();
+    std::cout << frames << " frames written to " << prefix << "_*.ppm" << std::endl;
+
+    delete supernova;
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool immediate = argc > 1 && std::string(argv[1]) == "--immediate";
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        std::size_t particleCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : BENCH_PARTICLES;
+        int steps = argc > 3 ? std::atoi(argv[3]) : BENCH_STEPS;
+        unsigned maxThreads = argc > 4 ? std::atoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+        return runBenchmark(particleCount, steps, maxThreads);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--offscreen") {
+        try {
+            return runOffscreen(std::atoi(argv[2]), argc > 3 ? argv[3] : "supernova");
+        } catch (const std::exception& e) {
+            std::cerr << "Offscreen export failed: " << e.what() << std::endl;
+            return -1;
+        }
+    }
+
+#ifdef SUPERNOVA_HEADLESS
+    (void)immediate;
+    std::cerr << "Usage: " << argv[0] << " --bench [PARTICLES] [STEPS] [MAX_THREADS] | --offscreen FRAMES [PREFIX]" << std::endl;
+    return -1;
+#else
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
         return -1;
@@ -82,16 +635,22 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
     glewInit();
 
-    supernova = new Supernova(500); // 创建超新星实例
+    supernova = new Supernova(MAX_PARTICLES, INITIAL_PARTICLES); // 创建超新星实例，粒子池一次分配到最大容量
+    supernova->setParticleCount(particleCount);
+    supernova->setSpawnRate(spawnRate);
 
     // 创建 GLUI 窗口
     GLUI *glui = GLUI_Master.create_glui("Control");
-    int particleCount = 500;
     GLUI_Spinner* particleSpinner = glui->add_spinner("Particle Count", GLUI_SPINNER_INT, &particleCount);
-    particleSpinner->set_int_limits(1, 2000);
+    particleSpinner->set_int_limits(1, MAX_PARTICLES);
     particleSpinner->set_callback((GLUI_Update_cb)updateParticleCount);
+    GLUI_Spinner* spawnSpinner = glui->add_spinner("Spawn Rate", GLUI_SPINNER_FLOAT, &spawnRate);
+    spawnSpinner->set_float_limits(0.0f, MAX_PARTICLES / (0.5f * PARTICLE_LIFESPAN));
+    spawnSpinner->set_callback((GLUI_Update_cb)updateSpawnRate);
+    glui->add_button("Burst", 0, (GLUI_Update_cb)triggerBurst);
 
     // OpenGL 视口设置
     glViewport(0, 0, WIDTH, HEIGHT);
@@ -100,29 +659,44 @@ int main() {
     gluPerspective(45.0, (float)WIDTH/(float)HEIGHT, 0.1, 100.0);
     glMatrixMode(GL_MODELVIEW);
 
+    FrameStats stats(immediate ? "Supernova, immediate mode" : "Supernova, VBO");
     float lastTime = glfwGetTime();
+    float accumulator = 0.0f;
     while (!glfwWindowShouldClose(window)) {
         float currentTime = glfwGetTime();
-        float deltaTime = currentTime - lastTime;
+        accumulator += std::min(currentTime - lastTime, MAX_FRAME_TIME);
         lastTime = currentTime;
 
+        // 以固定步长推进模拟，渲染帧率不影响模拟结果
+        while (accumulator >= SIM_TIME_STEP) {
+            supernova->update(SIM_TIME_STEP);
+            accumulator -= SIM_TIME_STEP;
+            stats.addSimulationSteps(1);
+        }
+
+        stats.beginFrame();
+
         // 清除窗口
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glLoadIdentity();
         glPointSize(2.0f);
 
-        // 更新超新星状态
-        supernova->update(deltaTime);
-        supernova->render();
+        if (immediate) {
+            supernova->renderImmediate();
+        } else {
+            supernova->render();
+        }
 
         // 更新 GLUI
         glui->sync_live();
         
         glfwSwapBuffers(window);
+        stats.endFrame();
         glfwPollEvents();
     }
 
     delete supernova; // 清理动态分配的内存
     glfwTerminate();
     return 0;
+#endif
 }
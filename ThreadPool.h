@@ -0,0 +1,259 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+
+// 固定大小的线程池。parallelFor 把区间切成固定大小的块，块的划分只取决于
+// grain 而与线程数无关；只要每块写入互不重叠的数据，结果就与线程数无关。
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+        : generation(0), stopping(false), busyWorkers(0) {
+        if (threads == 0) threads = 1;
+        // 调用线程本身也参与计算，因此只需创建 threads - 1 个工作线程
+        for (unsigned t = 1; t < threads; ++t) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // 并行执行 fn(blockBegin, blockEnd)，覆盖 [begin, end)，返回前等待所有块完成
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain,
+                     const std::function<void(std::size_t, std::size_t)>& fn) {
+        if (end <= begin) return;
+        if (grain == 0) grain = 1;
+        if (workers.empty() || end - begin <= grain) {
+            for (std::size_t b = begin; b < end; b += grain) {
+                fn(b, b + grain < end ? b + grain : end);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobEnd = end;
+            jobGrain = grain;
+            nextBlock.store(begin);
+            busyWorkers = static_cast<unsigned>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+
+        runBlocks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long generation;
+    bool stopping;
+    unsigned busyWorkers;
+
+    const std::function<void(std::size_t, std::size_t)>* job = nullptr;
+    std::size_t jobEnd = 0;
+    std::size_t jobGrain = 1;
+    std::atomic<std::size_t> nextBlock{0};
+
+    void runBlocks() {
+        for (;;) {
+            std::size_t b = nextBlock.fetch_add(jobGrain);
+            if (b >= jobEnd) break;
+            (*job)(b, b + jobGrain < jobEnd ? b + jobGrain : jobEnd);
+        }
+    }
+
+    void workerLoop() {
+        unsigned long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            runBlocks();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0) done.notify_one();
+            }
+        }
+    }
+};
+
+// 工作窃取线程池，用于大量相互独立、耗时差异大的任务（例如参数扫描中的各次模拟）。
+// 每个工作线程有自己的任务队列：按先进先出取自己的任务，队列空时窃取各队首中最早提交的任务，
+// 耗时长的任务不会让其余线程空等。任务按轮转顺序分配，因此大体按提交顺序开始执行，
+// 按顺序汇总结果的调用方只需暂存少量先完成的任务。任务参数是执行它的工作线程编号 [0, size())，
+// 便于每个线程复用自己的工作区。
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned)> Task;
+
+    explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency())
+        : queued(0), unfinished(0), nextQueue(0), stopping(false) {
+        if (threads == 0) threads = 1;
+        for (unsigned t = 0; t < threads; ++t) {
+            queues.emplace_back(new Queue());
+        }
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back(&WorkStealingPool::workerLoop, this, t);
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // 提交一个任务，按轮转顺序放入各线程的队列
+    void submit(Task task) {
+        std::size_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++unfinished;
+            sequence = nextQueue++;
+        }
+        Queue& queue = *queues[sequence % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Entry{sequence, std::move(task)});
+        }
+        queued.fetch_add(1);
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+
+    // 等待所有已提交的任务完成；若有任务抛出异常，在此重新抛出第一个异常
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return unfinished == 0; });
+        if (error) {
+            std::exception_ptr first = error;
+            error = nullptr;
+            std::rethrow_exception(first);
+        }
+    }
+
+private:
+    struct Entry {
+        std::size_t sequence; // 提交顺序
+        Task task;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Entry> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<long> queued; // 队列中的任务数，取走任务与计数之间可能短暂为负
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::size_t unfinished;
+    std::size_t nextQueue; // 下一个任务的提交序号，同时决定它进入的队列
+    bool stopping;
+    std::exception_ptr error;
+
+    // 先取自己队首的任务；自己的队列为空时，从队首序号最小的队列窃取。
+    // 扫描与窃取之间队首可能已被取走，此时重新扫描
+    bool take(unsigned self, Task& task) {
+        if (pop(*queues[self], std::numeric_limits<std::size_t>::max(), task)) return true;
+        for (;;) {
+            Queue* oldest = nullptr;
+            std::size_t sequence = std::numeric_limits<std::size_t>::max();
+            for (std::size_t k = 1; k < queues.size(); ++k) {
+                Queue& queue = *queues[(self + k) % queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (!queue.tasks.empty() && queue.tasks.front().sequence < sequence) {
+                    sequence = queue.tasks.front().sequence;
+                    oldest = &queue;
+                }
+            }
+            if (!oldest) return false;
+            if (pop(*oldest, sequence, task)) return true;
+        }
+    }
+
+    // 取出队首任务；expected 不是最大值时只在队首仍是该序号的任务时取出
+    bool pop(Queue& queue, std::size_t expected, Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (expected != std::numeric_limits<std::size_t>::max() && queue.tasks.front().sequence != expected) {
+            return false;
+        }
+        task = std::move(queue.tasks.front().task);
+        queue.tasks.pop_front();
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    void workerLoop(unsigned self) {
+        for (;;) {
+            Task task;
+            if (!take(self, task)) {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+                if (stopping) return;
+                continue;
+            }
+
+            std::exception_ptr failure;
+            try {
+                task(self);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure && !error) error = failure;
+            if (--unfinished == 0) done.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef TIME_SERIES_SINK_H
+#define TIME_SERIES_SINK_H
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// 输出格式：
+// CSV    逗号分隔的文本，数值格式与 std::ostream 默认格式一致
+// Binary 列式二进制："TSS1"、列数、各列名（长度 + 字节），之后是若干数据块，
+//        每块为行数（uint32）加上按列连续存放的 double
+enum class SinkFormat { CSV, Binary };
+
+struct SinkOptions {
+    SinkFormat format = SinkFormat::CSV;
+    bool append = false;               // 追加到已有文件（仅 CSV 与文本日志）
+    bool header = true;                // 新建 CSV 文件时写表头
+    std::size_t bufferBytes = 1 << 20; // 环形缓冲区大小，向上取整为 2 的幂，且至少容纳两行
+    bool threaded = true;              // false 时不建环形缓冲区与写线程，记录直接写入（带缓冲的）文件，
+                                       // 适合只偶尔写几行的日志
+};
+
+// 缓冲的异步时间序列输出。模拟循环只把记录追加到预先分配的环形缓冲区（单生产者），
+// 后台写线程负责格式化并写入文件；缓冲区满时 append 等待写线程腾出空间，不会丢数据。
+// columns 非空时每条记录是一行数值；columns 为空时是文本日志，每条记录是一行文本。
+// threaded 为 false 时同步写入，接口不变。
+class TimeSeriesSink {
+public:
+    TimeSeriesSink(const std::string& path, const std::vector<std::string>& columns,
+                   const SinkOptions& options = SinkOptions())
+        : path(path), columns(columns), format(options.format), threaded(options.threaded), head(0), tail(0),
+          producerWaiting(false), closing(false), flushRequested(0), flushCompleted(0), failed(false), blockRows(0) {
+        if (columns.empty() && format == SinkFormat::Binary) {
+            throw std::invalid_argument("文本日志不支持二进制列式格式: " + path);
+        }
+        if (threaded) {
+            std::size_t capacity = 4096;
+            while (capacity < options.bufferBytes || capacity < 2 * rowBytes()) capacity <<= 1;
+            ring.resize(capacity);
+            mask = capacity - 1;
+        }
+
+        const bool binary = format == SinkFormat::Binary;
+        const bool append = options.append && !binary;
+        bool existing = false;
+        if (append) {
+            std::ifstream probe(path, std::ios::binary | std::ios::ate);
+            existing = probe && probe.tellg() > 0;
+        }
+        file.open(path, binary ? std::ios::binary | std::ios::trunc
+                               : (append ? std::ios::app : std::ios::trunc));
+        if (!file) {
+            throw std::runtime_error("无法打开输出文件: " + path);
+        }
+
+        if (binary) {
+            file.write("TSS1", 4);
+            writeValue(static_cast<std::uint32_t>(columns.size()));
+            for (const auto& column : columns) {
+                writeValue(static_cast<std::uint32_t>(column.size()));
+                file.write(column.data(), column.size());
+            }
+            block.resize(columns.size() * BLOCK_ROWS);
+        } else if (!columns.empty() && options.header && !existing) {
+            for (std::size_t c = 0; c < columns.size(); ++c) {
+                file << (c ? "," : "") << columns[c];
+            }
+            file << "\n";
+        }
+        if (threaded) {
+            writer = std::thread(&TimeSeriesSink::writerLoop, this);
+        } else {
+            directRow.resize(columns.size());
+        }
+    }
+
+    ~TimeSeriesSink() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    TimeSeriesSink(const TimeSeriesSink&) = delete;
+    TimeSeriesSink& operator=(const TimeSeriesSink&) = delete;
+
+    std::size_t columnCount() const { return columns.size(); }
+
+    // 追加一行数值，values 的个数必须等于列数
+    void append(const double* values) {
+        if (columns.empty()) {
+            throw std::invalid_argument("文本日志不能追加数值行: " + path);
+        }
+        if (!threaded) {
+            std::copy(values, values + columns.size(), directRow.begin());
+            writeRow(directRow);
+            checkFile();
+            return;
+        }
+        reserve(rowBytes());
+        copyIn(values, rowBytes());
+        publish();
+    }
+
+    void append(std::initializer_list<double> values) {
+        if (values.size() != columns.size()) {
+            throw std::invalid_argument("列数不匹配: " + path);
+        }
+        append(values.begin());
+    }
+
+    // 追加一行文本（不含换行符）
+    void appendLine(const char* text, std::size_t length) {
+        if (!columns.empty()) {
+            throw std::invalid_argument("数值输出不能追加文本行: " + path);
+        }
+        if (!threaded) {
+            file.write(text, length);
+            file << "\n";
+            checkFile();
+            return;
+        }
+        const std::uint32_t size = static_cast<std::uint32_t>(length);
+        if (length + sizeof(size) > ring.size()) {
+            throw std::invalid_argument("日志行超过缓冲区大小: " + path);
+        }
+        reserve(sizeof(size) + length);
+        copyIn(&size, sizeof(size));
+        copyIn(text, length);
+        publish();
+    }
+
+    void appendLine(const std::string& text) { appendLine(text.data(), text.size()); }
+
+    // 等待此前追加的所有记录写入文件
+    void flush() {
+        if (!threaded) {
+            file.flush();
+            checkFile();
+            return;
+        }
+        if (!writer.joinable()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        const unsigned long ticket = ++flushRequested;
+        wake.notify_one();
+        progress.wait(lock, [&] { return flushCompleted >= ticket || failed; });
+        if (failed) throw std::runtime_error(error);
+    }
+
+    // 写出剩余记录并关闭文件；之后不能再追加
+    void close() {
+        if (!threaded) {
+            if (!file.is_open()) return;
+            writeBlock();
+            file.close();
+            checkFile();
+            return;
+        }
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wake.notify_one();
+        writer.join();
+        file.close();
+        if (failed) throw std::runtime_error(error);
+    }
+
+private:
+    static const std::size_t BLOCK_ROWS = 4096;
+
+    std::string path;
+    std::vector<std::string> columns;
+    SinkFormat format;
+    bool threaded;
+    std::ofstream file;
+    std::vector<double> directRow; // 同步模式下的行缓冲
+    std::vector<char> ring;
+    std::size_t mask = 0;
+    std::atomic<std::size_t> head; // 生产者的写入位置（单调递增）
+    std::atomic<std::size_t> tail; // 写线程的读取位置
+    std::size_t pending = 0;       // 生产者尚未发布的字节数
+    std::size_t lastWake = 0;
+    std::atomic<bool> producerWaiting; // 生产者正在 reserve 中等待空间
+
+    std::mutex mutex;
+    std::condition_variable wake;     // 唤醒写线程
+    std::condition_variable progress; // 通知生产者有空间或 flush 完成
+    bool closing;
+    unsigned long flushRequested;
+    unsigned long flushCompleted;
+    std::atomic<bool> failed;
+    std::string error;
+    std::thread writer;
+
+    std::vector<double> block; // 二进制格式的当前数据块，按列存放
+    std::size_t blockRows;
+
+    template <typename T>
+    void writeValue(const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    std::size_t rowBytes() const { return columns.size() * sizeof(double); }
+
+    void checkFile() {
+        if (!file) throw std::runtime_error("写入失败: " + path);
+    }
+
+    std::size_t used() const { return head.load(std::memory_order_relaxed) - tail.load(); }
+
+    void reserve(std::size_t bytes) {
+        if (failed) throw std::runtime_error(error);
+        if (ring.size() - used() >= bytes) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        // producerWaiting 与 tail 均为顺序一致的原子量：写线程要么看到等待标志并在持锁后通知，
+        // 要么在这里的谓词检查之前已推进 tail，因此不会丢失唤醒
+        producerWaiting = true;
+        wake.notify_one();
+        progress.wait(lock, [&] { return ring.size() - used() >= bytes || failed; });
+        producerWaiting = false;
+        if (failed) throw std::runtime_error(error);
+    }
+
+    void copyIn(const void* data, std::size_t bytes) {
+        const std::size_t position = (head.load(std::memory_order_relaxed) + pending) & mask;
+        const std::size_t first = std::min(bytes, ring.size() - position);
+        std::memcpy(&ring[position], data, first);
+        std::memcpy(&ring[0], static_cast<const char*>(data) + first, bytes - first);
+        pending += bytes;
+    }
+
+    void copyOut(std::size_t from, void* data, std::size_t bytes) const {
+        const std::size_t position = from & mask;
+        const std::size_t first = std::min(bytes, ring.size() - position);
+        std::memcpy(data, &ring[position], first);
+        std::memcpy(static_cast<char*>(data) + first, &ring[0], bytes - first);
+    }
+
+    // 发布一条完整记录；缓冲区用量每增加四分之一才唤醒一次写线程，其余时间写线程按超时轮询
+    void publish() {
+        const std::size_t end = head.load(std::memory_order_relaxed) + pending;
+        head.store(end, std::memory_order_release);
+        pending = 0;
+        if (end - lastWake >= ring.size() / 4) {
+            lastWake = end;
+            wake.notify_one();
+        }
+    }
+
+    void writerLoop() {
+        std::vector<double> row(columns.size());
+        std::string line;
+        for (;;) {
+            bool finishing;
+            unsigned long requested;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::milliseconds(50), [&] {
+                    return closing || flushRequested != flushCompleted || used() >= ring.size() / 4;
+                });
+                finishing = closing;
+                requested = flushRequested;
+            }
+
+            try {
+                drain(row, line);
+                if (finishing || requested != flushCompleted) {
+                    writeBlock();
+                    file.flush();
+                }
+                if (!file) throw std::runtime_error("写入失败: " + path);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                error = e.what();
+                failed = true;
+                progress.notify_all();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                flushCompleted = requested;
+                progress.notify_all();
+            }
+            if (finishing) return;
+        }
+    }
+
+    void drain(std::vector<double>& row, std::string& line) {
+        std::size_t position = tail.load(std::memory_order_relaxed);
+        const std::size_t end = head.load(std::memory_order_acquire);
+        while (position < end) {
+            if (columns.empty()) {
+                std::uint32_t size;
+                copyOut(position, &size, sizeof(size));
+                line.resize(size);
+                copyOut(position + sizeof(size), &line[0], size);
+                position += sizeof(size) + size;
+                file << line << "\n";
+            } else {
+                copyOut(position, row.data(), row.size() * sizeof(double));
+                position += row.size() * sizeof(double);
+                writeRow(row);
+            }
+            // 每条记录读出后即归还空间，生产者不必等整批写完；生产者在等待时持锁通知
+            tail.store(position);
+            if (producerWaiting && used() < ring.size() / 2) notifyProgress();
+        }
+        if (producerWaiting) notifyProgress();
+    }
+
+    void notifyProgress() {
+        std::lock_guard<std::mutex> lock(mutex);
+        progress.notify_all();
+    }
+
+    void writeRow(const std::vector<double>& row) {
+        if (format == SinkFormat::CSV) {
+            for (std::size_t c = 0; c < row.size(); ++c) {
+                if (c) file << ",";
+                file << row[c];
+            }
+            file << "\n";
+            return;
+        }
+        for (std::size_t c = 0; c < row.size(); ++c) {
+            block[c * BLOCK_ROWS + blockRows] = row[c];
+        }
+        if (++blockRows == BLOCK_ROWS) writeBlock();
+    }
+
+    void writeBlock() {
+        if (format != SinkFormat::Binary || blockRows == 0) return;
+        writeValue(static_cast<std::uint32_t>(blockRows));
+        for (std::size_t c = 0; c < columns.size(); ++c) {
+            file.write(reinterpret_cast<const char*>(&block[c * BLOCK_ROWS]), blockRows * sizeof(double));
+        }
+        blockRows = 0;
+    }
+};
+
+#endif
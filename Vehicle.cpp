@@ -5,9 +5,19 @@
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
-#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <string>
 #include <ctime>
 #include <cstdlib>
+#include <atomic>
+#include <cstdint>
+#include "ThreadPool.h"
+#include "TimeSeriesSink.h"
 
 // 参数类用于管理超参数设置
 class Parameters {
@@ -19,6 +29,14 @@ public:
     double min_alpha = 0.01;         // 最小学习率
     double decay_alpha = 0.99;       // 学习率衰减因子
     double initial_gamma = 0.9;      // 初始折扣因子
+    double state_min = -M_PI;        // 状态（角度误差）编码范围
+    double state_max = M_PI;
+    int state_bins = 32;             // 每组分格的格数
+    int tilings = 4;                 // 相互错开的分格组数，1 表示普通离散化
+    int replay_capacity = 4096;      // 经验回放缓冲区容量
+    int batch_size = 16;             // 每次训练抽取的经验数
+    int train_interval = 1;          // 每隔多少次更新训练一批
+    unsigned int seed = 0;           // 随机数种子，0 表示按当前时间
 };
 
 // 模糊控制器
@@ -31,27 +49,94 @@ public:
     }
 };
 
-// Q-learning 代理
-class QLearningAgent {
+// 状态编码（tile coding）：把连续的角度误差映射到若干组相互错开的均匀分格，
+// 每组分格给出一个特征编号。tilings = 1 时就是普通的等宽离散化。
+// 特征总数固定为 tilings * (bins + 1)，与访问过多少个不同状态无关。
+class TileCoder {
 public:
-    QLearningAgent(const Parameters& params) 
-        : epsilon_(params.initial_epsilon), 
-          alpha_(params.initial_alpha), 
-          gamma_(params.initial_gamma) {
-        srand(static_cast<unsigned int>(time(0)));
+    TileCoder(double min_value, double max_value, int bins, int tilings)
+        : min_(min_value), max_(max_value), bins_(bins), tilings_(tilings) {
+        if (bins <= 0 || tilings <= 0 || !(max_value > min_value)) {
+            throw std::invalid_argument("Invalid tile coding parameters.");
+        }
+        inverse_width_ = bins / (max_value - min_value);
+    }
+
+    int tilings() const { return tilings_; }
+    int featureCount() const { return tilings_ * (bins_ + 1); }
+
+    // 各组分格的边界都落在宽为 1 / tilings 格的细分点上，同一细分格内所有状态的编码相同
+    int fineCellCount() const { return bins_ * tilings_; }
+    double minValue() const { return min_; }
+    double fineCellScale() const { return inverse_width_ * tilings_; }
+    double fineCellCenter(int cell) const { return min_ + (cell + 0.5) / fineCellScale(); }
+
+    // 把状态在每组分格中的特征编号写入 features[0, tilings)；超出范围的状态归入两端的细分格，
+    // 与细分格上的贪心策略表一致（>= max 的状态按最后一个细分格编码，而不是落到其外侧）
+    void encode(double state, int* features) const {
+        const double clamped = std::min(std::max(state, min_), max_);
+        const double scaled = std::min((clamped - min_) * inverse_width_, bins_ - 0.5 / tilings_);
+        for (int t = 0; t < tilings_; ++t) {
+            // 第 t 组分格整体偏移 t / tilings 个格宽
+            const int bin = static_cast<int>(scaled + static_cast<double>(t) / tilings_);
+            features[t] = t * (bins_ + 1) + std::min(bin, bins_);
+        }
     }
 
+private:
+    double min_, max_;
+    double inverse_width_;
+    int bins_, tilings_;
+};
+
+// 可选的动作：减速或加速
+const int ACTION_COUNT = 2;
+const double ACTIONS[ACTION_COUNT] = {-1.0, 1.0};
+
+// Q-learning 代理。Q 值存放在连续数组 q_[feature * ACTION_COUNT + action] 中，
+// 查询只需编码状态后按下标读取，不做哈希，内存大小在构造时确定。
+// 经验存入固定容量的回放环形缓冲区，每次更新从中随机抽取一批经验：
+// 先用同一份 Q 值计算整批 TD 误差，再统一写回。
+class QLearningAgent {
+public:
+    QLearningAgent(const Parameters& params)
+        : epsilon_(params.initial_epsilon),
+          alpha_(params.initial_alpha),
+          gamma_(params.initial_gamma),
+          params_(params),
+          coder_(params.state_min, params.state_max, params.state_bins, params.tilings),
+          q_(static_cast<std::size_t>(coder_.featureCount()) * ACTION_COUNT, 0.0),
+          replay_(std::max(params.replay_capacity, 1)),
+          replay_next_(0), replay_size_(0), step_count_(0),
+          batch_features_(static_cast<std::size_t>(std::max(params.batch_size, 1)) * coder_.tilings()),
+          batch_deltas_(std::max(params.batch_size, 1)),
+          batch_actions_(std::max(params.batch_size, 1)),
+          features_(coder_.tilings()),
+          rng_(params.seed ? params.seed : static_cast<unsigned int>(time(0))) {}
+
     void chooseAction(double state) {
-        if (rand() / static_cast<double>(RAND_MAX) < epsilon_) {
-            action_ = (rand() % 2) ? 1.0 : -1.0; // 随机选择
+        if (uniform_(rng_) < epsilon_) {
+            action_index_ = static_cast<int>(rng_() % ACTION_COUNT); // 随机选择
         } else {
-            action_ = getMaxAction(state); // 选择最佳动作
+            coder_.encode(state, features_.data());
+            action_index_ = bestAction(features_.data()); // 选择最佳动作
         }
     }
 
-    void update(double state, double reward) {
-        double best_next_action = getMaxAction(state);
-        q_table_[state][action_] += alpha_ * (reward + gamma_ * best_next_action - q_table_[state][action_]);
+    // 记录一次经验 (state, action, reward, next_state)，回放缓冲区积累到一批后每步训练一批
+    void update(double state, double reward, double next_state) {
+        Transition& transition = replay_[replay_next_];
+        transition.state = state;
+        transition.next_state = next_state;
+        transition.reward = reward;
+        transition.action = action_index_;
+        replay_next_ = (replay_next_ + 1) % replay_.size();
+        replay_size_ = std::min(replay_size_ + 1, replay_.size());
+
+        const std::size_t batch = batch_deltas_.size();
+        if (replay_size_ >= batch && ++step_count_ % std::max(params_.train_interval, 1) == 0) {
+            trainBatch();
+        }
 
         // 动态调整学习率与探索率
         updateAlpha();
@@ -59,121 +144,555 @@ public:
     }
 
     double getAction() const {
-        return action_;
+        return ACTIONS[action_index_];
+    }
+
+    double qValue(double state, int action_index) const {
+        std::vector<int> features(coder_.tilings());
+        coder_.encode(state, features.data());
+        return value(features.data(), action_index);
+    }
+
+    // 贪心策略表：每个细分格的贪心动作，与逐次比较该格内状态的 Q 值结果相同
+    void greedyPolicy(std::vector<double>& actions) {
+        actions.resize(coder_.fineCellCount());
+        for (int cell = 0; cell < coder_.fineCellCount(); ++cell) {
+            coder_.encode(coder_.fineCellCenter(cell), features_.data());
+            actions[cell] = ACTIONS[bestAction(features_.data())];
+        }
     }
 
+    const TileCoder& coder() const { return coder_; }
+
+    std::size_t tableBytes() const { return q_.size() * sizeof(double) + replay_.size() * sizeof(Transition); }
+
 private:
-    double action_;
+    struct Transition {
+        double state;
+        double next_state;
+        double reward;
+        int action;
+    };
+
+    int action_index_ = 0;
     double epsilon_, alpha_, gamma_;
-    std::unordered_map<double, std::unordered_map<double, double>> q_table_; // Q 表
+    Parameters params_;
+    TileCoder coder_;
+    std::vector<double> q_; // Q 表
+    std::vector<Transition> replay_;
+    std::size_t replay_next_, replay_size_;
+    unsigned long step_count_;
+    std::vector<int> batch_features_; // 每条经验占 tilings 个
+    std::vector<double> batch_deltas_;
+    std::vector<int> batch_actions_;
+    std::vector<int> features_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
 
-    double getMaxAction(double state) {
-        double max_value = -std::numeric_limits<double>::infinity();
-        double best_action = 0.0;
+    double value(const int* features, int action_index) const {
+        double sum = 0.0;
+        for (int t = 0; t < coder_.tilings(); ++t) {
+            sum += q_[static_cast<std::size_t>(features[t]) * ACTION_COUNT + action_index];
+        }
+        return sum;
+    }
 
-        for (const auto& action_pair : q_table_[state]) {
-            if (action_pair.second > max_value) {
-                max_value = action_pair.second;
-                best_action = action_pair.first;
+    int bestAction(const int* features) const {
+        double max_value = -std::numeric_limits<double>::infinity();
+        int best_action = 0;
+        for (int a = 0; a < ACTION_COUNT; ++a) {
+            const double q = value(features, a);
+            if (q > max_value) {
+                max_value = q;
+                best_action = a;
             }
         }
         return best_action;
     }
 
+    void trainBatch() {
+        const int tilings = coder_.tilings();
+        const std::size_t batch = batch_deltas_.size();
+        std::uniform_int_distribution<std::size_t> pick(0, replay_size_ - 1);
+
+        // 第一遍：用同一份 Q 值计算整批的 TD 误差
+        for (std::size_t b = 0; b < batch; ++b) {
+            const Transition& transition = replay_[pick(rng_)];
+            int* features = &batch_features_[b * tilings];
+            coder_.encode(transition.state, features);
+            coder_.encode(transition.next_state, features_.data());
+            const double target = transition.reward + gamma_ * value(features_.data(), bestAction(features_.data()));
+            batch_deltas_[b] = target - value(features, transition.action);
+            batch_actions_[b] = transition.action;
+        }
+
+        // 第二遍：写回。每组分格各承担 1 / tilings 的步长，整批取平均
+        const double step = alpha_ / (tilings * static_cast<double>(batch));
+        for (std::size_t b = 0; b < batch; ++b) {
+            const int* features = &batch_features_[b * tilings];
+            for (int t = 0; t < tilings; ++t) {
+                q_[static_cast<std::size_t>(features[t]) * ACTION_COUNT + batch_actions_[b]] += step * batch_deltas_[b];
+            }
+        }
+    }
+
     void updateEpsilon() {
-        if (epsilon_ > 0.05) { 
-            epsilon_ *= decay_factor; // 衰减
+        if (epsilon_ > params_.min_epsilon) {
+            epsilon_ *= params_.decay_factor; // 衰减
         }
     }
 
     void updateAlpha() {
-        if (alpha_ > 0.01) { 
-            alpha_ *= decay_alpha; // 衰减
+        if (alpha_ > params_.min_alpha) {
+            alpha_ *= params_.decay_alpha; // 衰减
         }
     }
 };
 
-// 车辆类
-class Vehicle {
+// 可向量化的 sin / cos：按 π/2 的整数倍做区间约化（Cody-Waite 两段常数），在 [-π/4, π/4] 上
+// 用 Taylor 多项式，象限用条件选择而不是分支，编译器可以把调用它的循环整体向量化。
+// 取整用加减 1.5 * 2^52 的方法而不是 std::floor（后者在默认浮点选项下不能向量化）。
+// 在 |x| < 1e6 内误差约为 1e-16 量级
+inline void sinCos(double x, double& sine, double& cosine) {
+    const double PIO2_HI = 1.57079632673412561417e+00; // π/2 的高 33 位
+    const double PIO2_LO = 6.07710050650619224932e-11; // π/2 - PIO2_HI
+    const double ROUND = 6755399441055744.0;            // 1.5 * 2^52
+    const double n = (x * (2.0 / M_PI) + ROUND) - ROUND;
+    const double r = (x - n * PIO2_HI) - n * PIO2_LO;
+    const double r2 = r * r;
+    const double s = r * (1.0 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880 +
+                     r2 * (-1.0 / 39916800 + r2 * (1.0 / 6227020800.0 + r2 * (-1.0 / 1307674368000.0))))))));
+    const double c = 1.0 + r2 * (-0.5 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320 + r2 * (-1.0 / 3628800 +
+                     r2 * (1.0 / 479001600 + r2 * (-1.0 / 87178291200.0 + r2 * (1.0 / 20922789888000.0))))))));
+    const int quadrant = static_cast<int>(n) & 3;
+    sine = quadrant == 0 ? s : (quadrant == 1 ? c : (quadrant == 2 ? -s : -c));
+    cosine = quadrant == 0 ? c : (quadrant == 1 ? -s : (quadrant == 2 ? -c : s));
+}
+
+// 轨迹记录选项
+struct RecorderOptions {
+    std::size_t capacity = 1024;          // 每辆车缓冲的采样数
+    unsigned decimation = 1;              // 每隔多少次更新采样一次
+    bool keepLatest = false;              // true：缓冲区满后覆盖最旧的采样，只保留最近 capacity 个；
+                                          // false：缓冲区满时先写出再继续记录
+    SinkFormat format = SinkFormat::CSV;
+};
+
+// 车辆轨迹记录器。每辆车在构造时分配固定容量的环形缓冲区（全部车辆共用一块连续内存），
+// record() 只写入缓冲区、不分配内存；flush() 按车辆、时间顺序把缓冲的采样交给
+// TimeSeriesSink，由其后台线程写成 CSV 或列式二进制文件。
+// 不同车辆的 record() 可以由不同线程同时调用。
+class TrajectoryRecorder {
 public:
-    Vehicle(double x, double y, double theta, const Parameters& params)
-        : x_(x), y_(y), theta_(theta), v_(0.0), omega_(0.0),
-          target_velocity_(0.0), target_angle_(0.0),
-          pid_kp_(1.0), pid_ki_(0.1), pid_kd_(0.01),
-          integral_(0.0), previous_error_(0.0), 
-          rlAgent_(params) {}
+    TrajectoryRecorder(const std::string& path, std::size_t vehicles, const RecorderOptions& options = RecorderOptions())
+        : capacity_(std::max<std::size_t>(options.capacity, 1)),
+          decimation_(std::max(options.decimation, 1u)),
+          keep_latest_(options.keepLatest),
+          samples_(vehicles * capacity_ * SAMPLE_FIELDS),
+          updates_(vehicles, 0), fill_(vehicles, 0), start_(vehicles, 0),
+          any_full_(false),
+          sink_(path, {"vehicle", "step", "x", "y", "theta"}, sinkOptions(options.format)) {}
 
-    void setControls(double target_velocity, double target_angle) {
-        target_velocity_ = target_velocity;
-        target_angle_ = target_angle;
+    std::size_t vehicleCount() const { return updates_.size(); }
+
+    // 车辆 vehicle 完成一次更新后调用；按抽样间隔写入其环形缓冲区
+    void record(std::size_t vehicle, double x, double y, double theta) {
+        const std::uint64_t update = updates_[vehicle]++;
+        if (update % decimation_ != 0) return;
+
+        std::size_t& fill = fill_[vehicle];
+        std::size_t slot;
+        if (fill < capacity_) {
+            slot = (start_[vehicle] + fill++) % capacity_;
+            if (fill == capacity_ && !keep_latest_) any_full_.store(true, std::memory_order_relaxed);
+        } else {
+            slot = start_[vehicle]; // 覆盖最旧的采样
+            start_[vehicle] = (start_[vehicle] + 1) % capacity_;
+        }
+        double* sample = &samples_[(vehicle * capacity_ + slot) * SAMPLE_FIELDS];
+        sample[0] = static_cast<double>(update);
+        sample[1] = x;
+        sample[2] = y;
+        sample[3] = theta;
     }
 
-    void update(double dt) {
-        double velocity_error = target_velocity_ - v_;
-        v_ += pidControl(velocity_error, dt);
-        
-        double angle_error = target_angle_ - theta_;
-        omega_ = pidControl(angle_error, dt);
+    // 是否有车辆的缓冲区已满、需要先 flush() 才能继续记录（keepLatest 模式下始终为 false）
+    bool full() const { return any_full_.load(std::memory_order_relaxed); }
+
+    // 写出所有缓冲的采样并清空缓冲区
+    void flush() {
+        double row[SAMPLE_FIELDS + 1];
+        for (std::size_t vehicle = 0; vehicle < fill_.size(); ++vehicle) {
+            row[0] = static_cast<double>(vehicle);
+            for (std::size_t k = 0; k < fill_[vehicle]; ++k) {
+                const std::size_t slot = (start_[vehicle] + k) % capacity_;
+                const double* sample = &samples_[(vehicle * capacity_ + slot) * SAMPLE_FIELDS];
+                std::copy(sample, sample + SAMPLE_FIELDS, row + 1);
+                sink_.append(row);
+            }
+            fill_[vehicle] = 0;
+            start_[vehicle] = 0;
+        }
+        any_full_.store(false, std::memory_order_relaxed);
+    }
+
+    // 写出剩余采样并关闭文件
+    void close() {
+        flush();
+        sink_.close();
+    }
+
+private:
+    static const std::size_t SAMPLE_FIELDS = 4; // step, x, y, theta
+
+    std::size_t capacity_;
+    std::uint64_t decimation_;
+    bool keep_latest_;
+    std::vector<double> samples_;        // [vehicle][slot][field]
+    std::vector<std::uint64_t> updates_; // 每辆车已记录的更新次数
+    std::vector<std::size_t> fill_;      // 每辆车缓冲的采样数
+    std::vector<std::size_t> start_;     // 每辆车最旧采样所在的槽位
+    std::atomic<bool> any_full_;
+    TimeSeriesSink sink_;
+
+    static SinkOptions sinkOptions(SinkFormat format) {
+        SinkOptions options;
+        options.format = format;
+        return options;
+    }
+};
+
+// 车队状态（结构数组）：每个分量占一段连续内存
+struct FleetState {
+    std::vector<double> x, y, theta;                     // 车辆位置和朝向
+    std::vector<double> v, omega;                        // 控制输入
+    std::vector<double> integral, previous_error;        // PID 控制器状态
+    std::vector<double> target_velocity, target_angle;   // 期望速度和角度
+
+    std::size_t size() const { return x.size(); }
+};
+
+// 车队：所有车辆的状态按结构数组存放，共享 PID 参数、模糊控制器与 Q-learning 代理。
+// step() 用代理当前的贪心策略批量推进整个车队，车队按区间分给线程池，
+// 每个区间内的循环没有分支和不可内联的调用，可以被编译器向量化；每辆车只依赖自身状态，
+// 结果与线程数无关。updateLearning() 逐辆推进并在线学习，供单车 API 使用。
+class VehicleFleet {
+public:
+    explicit VehicleFleet(const Parameters& params, unsigned threads = std::thread::hardware_concurrency())
+        : pid_kp_(1.0), pid_ki_(0.1), pid_kd_(0.01), rlAgent_(params), pool_(threads) {}
+
+    void reserve(std::size_t count) {
+        for (std::vector<double>* component : {&state_.x, &state_.y, &state_.theta, &state_.v, &state_.omega,
+                                               &state_.integral, &state_.previous_error, &state_.target_velocity,
+                                               &state_.target_angle}) {
+            component->reserve(count);
+        }
+    }
+
+    // 添加一辆车，返回其编号
+    std::size_t add(double x, double y, double theta) {
+        state_.x.push_back(x);
+        state_.y.push_back(y);
+        state_.theta.push_back(theta);
+        state_.v.push_back(0.0);
+        state_.omega.push_back(0.0);
+        state_.integral.push_back(0.0);
+        state_.previous_error.push_back(0.0);
+        state_.target_velocity.push_back(0.0);
+        state_.target_angle.push_back(0.0);
+        return state_.size() - 1;
+    }
+
+    std::size_t size() const { return state_.size(); }
+    const FleetState& state() const { return state_; }
+
+    // 之后每次更新都把车辆位姿交给 recorder（不转移所有权，nullptr 表示停止记录）
+    void setRecorder(TrajectoryRecorder* recorder) {
+        if (recorder && recorder->vehicleCount() < state_.size()) {
+            throw std::invalid_argument("Trajectory recorder has fewer slots than the fleet.");
+        }
+        recorder_ = recorder;
+    }
+    QLearningAgent& agent() { return rlAgent_; }
+
+    void setControls(std::size_t i, double target_velocity, double target_angle) {
+        state_.target_velocity[i] = target_velocity;
+        state_.target_angle[i] = target_angle;
+    }
+
+    // 单辆车推进一步并更新 Q-learning 代理
+    void updateLearning(std::size_t i, double dt) {
+        double velocity_error = state_.target_velocity[i] - state_.v[i];
+        state_.v[i] += pidControl(i, velocity_error, dt);
+
+        double angle_error = state_.target_angle[i] - state_.theta[i];
+        state_.omega[i] = pidControl(i, angle_error, dt);
 
         // 使用模糊控制器调整角速度
-        omega_ += fuzzy_.control(angle_error);
+        state_.omega[i] += fuzzy_.control(angle_error);
 
         // 使用 Q-learning 代理选择行为
         rlAgent_.chooseAction(angle_error);
-        v_ += rlAgent_.getAction(); // 更新速度基于强化学习的动作
+        state_.v[i] += rlAgent_.getAction(); // 更新速度基于强化学习的动作
 
         // 更新车辆状态
-        x_ += v_ * cos(theta_) * dt;
-        y_ += v_ * sin(theta_) * dt;
-        theta_ += omega_ * dt;
+        double sine, cosine;
+        sinCos(state_.theta[i], sine, cosine);
+        state_.x[i] += state_.v[i] * cosine * dt;
+        state_.y[i] += state_.v[i] * sine * dt;
+        state_.theta[i] += state_.omega[i] * dt;
 
-        // 更新 Q-learning
-        double reward = calculateReward();
-        rlAgent_.update(angle_error, reward);
-    }
+        // 更新 Q-learning：经验为 (更新前的角度误差, 动作, 奖励, 更新后的角度误差)
+        double reward = calculateReward(i);
+        rlAgent_.update(angle_error, reward, state_.target_angle[i] - state_.theta[i]);
 
-    void saveToCSV(const std::string& filename) const {
-        std::ofstream csvFile(filename);
-        if (!csvFile) {
-            throw std::runtime_error("Unable to open CSV file.");
+        if (recorder_) {
+            if (recorder_->full()) recorder_->flush();
+            recorder_->record(i, state_.x[i], state_.y[i], state_.theta[i]);
         }
-        csvFile << "x,y,theta\n";  // CSV Header
-        csvFile << std::fixed << std::setprecision(2) << x_ << "," << y_ << "," << theta_ << "\n";
-        csvFile.close();
+    }
+
+    // 按当前贪心策略批量推进所有车辆（不探索、不学习）
+    void step(double dt) {
+        refreshPolicy();
+        if (recorder_ && recorder_->full()) recorder_->flush();
+        pool_.parallelFor(0, state_.size(), BLOCK_SIZE, [this, dt](std::size_t begin, std::size_t end) {
+            stepRange(begin, end, dt);
+            if (recorder_) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    recorder_->record(i, state_.x[i], state_.y[i], state_.theta[i]);
+                }
+            }
+        });
     }
 
 private:
-    double x_, y_, theta_; // 车辆位置和朝向
-    double v_, omega_; // 控制输入
-    double target_velocity_, target_angle_; // 期望速度和角度
+    static const std::size_t BLOCK_SIZE = 4096; // 每个并行任务处理的车辆数
+
+    FleetState state_;
 
     // PID 控制器参数
     double pid_kp_, pid_ki_, pid_kd_;
-    double integral_, previous_error_;
-    
+
     QLearningAgent rlAgent_;
     FuzzyController fuzzy_; // 模糊控制器实例
+    std::vector<double> policy_;        // 贪心策略表，按细分格编号
+    double policy_base_ = 0.0;          // 最左细分格的动作
+    std::vector<double> switch_points_; // 动作发生变化的角度误差，升序
+    std::vector<double> switch_jumps_;  // 对应的动作变化量
+    ThreadPool pool_;
+    TrajectoryRecorder* recorder_ = nullptr;
 
-    double pidControl(double error, double dt) {
-        integral_ += error * dt;
-        double derivative = (error - previous_error_) / dt;
-        previous_error_ = error;
+    // 速度与角度两个 PID 回路共用积分项与上一误差（沿用原单车模型）
+    double pidControl(std::size_t i, double error, double dt) {
+        state_.integral[i] += error * dt;
+        double derivative = (error - state_.previous_error[i]) / dt;
+        state_.previous_error[i] = error;
 
         // PID 输出
-        return pid_kp_ * error + pid_ki_ * integral_ + pid_kd_ * derivative;
+        return pid_kp_ * error + pid_ki_ * state_.integral[i] + pid_kd_ * derivative;
     }
 
-    double calculateReward() const {
+    double calculateReward(std::size_t i) const {
         // 简单的奖励函数设计
-        return (std::abs(target_angle_ - theta_) < 0.1) ? 10.0 : -1.0; // 接近目标与远离目标
+        return (std::abs(state_.target_angle[i] - state_.theta[i]) < 0.1) ? 10.0 : -1.0; // 接近目标与远离目标
+    }
+
+    // 贪心策略在细分格上分段为常数，改写为最左格的动作加上各切换点处的跳变，
+    // 批量推进时用比较代替查表（查表需要 gather，在默认编译选项下不能向量化）
+    void refreshPolicy() {
+        rlAgent_.greedyPolicy(policy_);
+        const TileCoder& coder = rlAgent_.coder();
+        policy_base_ = policy_[0];
+        switch_points_.clear();
+        switch_jumps_.clear();
+        switch_points_.reserve(policy_.size());
+        switch_jumps_.reserve(policy_.size());
+        for (std::size_t cell = 1; cell < policy_.size(); ++cell) {
+            if (policy_[cell] == policy_[cell - 1]) continue;
+            switch_points_.push_back(coder.minValue() + cell / coder.fineCellScale());
+            switch_jumps_.push_back(policy_[cell] - policy_[cell - 1]);
+        }
+    }
+
+    // 与 updateLearning 相同的动力学，分三遍处理一个区间，每一遍都是可向量化的简单循环；
+    // 区间不超过 BLOCK_SIZE 辆车，各数组在三遍之间保持在缓存中
+    void stepRange(std::size_t begin, std::size_t end, double dt) {
+        FleetState& s = state_;
+        controlPass(begin, end, dt, pid_kp_, pid_ki_, pid_kd_, policy_base_, s.target_velocity.data(),
+                    s.target_angle.data(), s.theta.data(), s.v.data(), s.omega.data(), s.integral.data(),
+                    s.previous_error.data());
+        for (std::size_t k = 0; k < switch_points_.size(); ++k) {
+            actionPass(begin, end, switch_points_[k], switch_jumps_[k], s.target_angle.data(), s.theta.data(),
+                       s.v.data());
+        }
+        motionPass(begin, end, dt, s.v.data(), s.omega.data(), s.x.data(), s.y.data(), s.theta.data());
+    }
+
+    // 以下各遍的数组互不重叠，参数用 __restrict 告知编译器，省去逐对的别名检查
+
+    // 第一遍：PID 与模糊控制，加上最左格的动作
+    static void controlPass(std::size_t begin, std::size_t end, double dt, double kp, double ki, double kd, double base,
+                            const double* __restrict target_velocity, const double* __restrict target_angle,
+                            const double* __restrict theta, double* __restrict v, double* __restrict omega,
+                            double* __restrict integral, double* __restrict previous_error) {
+        for (std::size_t i = begin; i < end; ++i) {
+            double sum = integral[i];
+            const double velocity_error = target_velocity[i] - v[i];
+            sum += velocity_error * dt;
+            const double velocity = v[i] + (kp * velocity_error + ki * sum + kd * ((velocity_error - previous_error[i]) / dt));
+
+            const double angle_error = target_angle[i] - theta[i];
+            sum += angle_error * dt;
+            double angular = kp * angle_error + ki * sum + kd * ((angle_error - velocity_error) / dt);
+            angular += angle_error > 0.1 ? 1.0 : (angle_error < -0.1 ? -1.0 : 0.0);
+
+            v[i] = velocity + base;
+            omega[i] = angular;
+            integral[i] = sum;
+            previous_error[i] = angle_error;
+        }
+    }
+
+    // 第二遍：角度误差越过切换点的车辆叠加动作的跳变
+    static void actionPass(std::size_t begin, std::size_t end, double point, double jump,
+                           const double* __restrict target_angle, const double* __restrict theta, double* __restrict v) {
+        for (std::size_t i = begin; i < end; ++i) {
+            v[i] += target_angle[i] - theta[i] >= point ? jump : 0.0;
+        }
+    }
+
+    // 第三遍：更新车辆位置和朝向
+    static void motionPass(std::size_t begin, std::size_t end, double dt, const double* __restrict v,
+                           const double* __restrict omega, double* __restrict x, double* __restrict y,
+                           double* __restrict theta) {
+        for (std::size_t i = begin; i < end; ++i) {
+            double sine, cosine;
+            sinCos(theta[i], sine, cosine);
+            x[i] += v[i] * cosine * dt;
+            y[i] += v[i] * sine * dt;
+            theta[i] += omega[i] * dt;
+        }
+    }
+};
+
+// 车辆类：车队中一辆车的视图。独立构造时内部持有只含这一辆车的车队
+class Vehicle {
+public:
+    Vehicle(double x, double y, double theta, const Parameters& params)
+        : owned_(new VehicleFleet(params, 1)), fleet_(owned_.get()), index_(owned_->add(x, y, theta)) {}
+
+    Vehicle(VehicleFleet& fleet, std::size_t index) : fleet_(&fleet), index_(index) {}
+
+    void setControls(double target_velocity, double target_angle) {
+        fleet_->setControls(index_, target_velocity, target_angle);
+    }
+
+    void update(double dt) {
+        fleet_->updateLearning(index_, dt);
     }
+
+    // 记录轨迹；对车队中的视图而言作用于整个车队
+    void setRecorder(TrajectoryRecorder* recorder) { fleet_->setRecorder(recorder); }
+
+    double x() const { return fleet_->state().x[index_]; }
+    double y() const { return fleet_->state().y[index_]; }
+    double theta() const { return fleet_->state().theta[index_]; }
+
+    void saveToCSV(const std::string& filename) const {
+        std::ofstream csvFile(filename);
+        if (!csvFile) {
+            throw std::runtime_error("Unable to open CSV file.");
+        }
+        csvFile << "x,y,theta\n";  // CSV Header
+        csvFile << std::fixed << std::setprecision(2) << x() << "," << y() << "," << theta() << "\n";
+        csvFile.close();
+    }
+
+private:
+    std::unique_ptr<VehicleFleet> owned_;
+    VehicleFleet* fleet_;
+    std::size_t index_;
 };
 
-int main() {
+// 车队吞吐量测试：以 1..maxThreads 个线程批量推进同一车队，报告每秒车辆步数，并检查结果与单线程一致
+int runFleetBenchmark(std::size_t vehicles, int steps, unsigned maxThreads) {
+    const double dt = 0.1;
+    Parameters params;
+    params.seed = 1;
+    std::vector<double> reference;
+    double baseSeconds = 0.0;
+    bool allIdentical = true;
+
+    std::cout << "threads,seconds,Mvehicle_steps_per_s,speedup,identical" << std::endl;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        VehicleFleet fleet(params, threads);
+        fleet.reserve(vehicles);
+        for (std::size_t i = 0; i < vehicles; ++i) {
+            fleet.add(0.0, 0.0, std::fmod(i * 0.618, 2 * M_PI) - M_PI);
+            fleet.setControls(i, 1.0 + (i % 7) * 0.1, 0.0);
+        }
+        // 先用第 0 辆车在线学习一段时间，得到非平凡的策略
+        for (int k = 0; k < 2000; ++k) fleet.updateLearning(0, dt);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; ++step) {
+            fleet.step(dt);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const FleetState& state = fleet.state();
+        std::vector<double> result(state.x);
+        result.insert(result.end(), state.y.begin(), state.y.end());
+        result.insert(result.end(), state.theta.begin(), state.theta.end());
+        bool identical = true;
+        if (reference.empty()) {
+            reference.swap(result);
+            baseSeconds = seconds;
+        } else {
+            identical = result == reference;
+            allIdentical = allIdentical && identical;
+        }
+        std::cout << threads << "," << seconds << "," << vehicles * static_cast<double>(steps) / seconds / 1e6 << ","
+                  << baseSeconds / seconds << "," << (identical ? "yes" : "NO") << std::endl;
+    }
+
+    if (!allIdentical) {
+        std::cerr << "Multithreaded result differs from single-threaded result" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--fleet") {
+        std::size_t vehicles = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+        int steps = argc > 3 ? std::atoi(argv[3]) : 100;
+        unsigned maxThreads = argc > 4 ? std::max(1, std::atoi(argv[4])) : std::max(1u, std::thread::hardware_concurrency());
+        return runFleetBenchmark(vehicles, steps, maxThreads);
+    }
+
+    RecorderOptions recorderOptions;
+    bool binaryTrajectory = false;
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--binary") {
+            binaryTrajectory = true;
+            recorderOptions.format = SinkFormat::Binary;
+        } else if (arg == "--decimation" && a + 1 < argc) {
+            recorderOptions.decimation = static_cast<unsigned>(std::max(1, std::atoi(argv[++a])));
+        }
+    }
+
     try {
         Parameters params; // 创建参数实例
         Vehicle vehicle(0.0, 0.0, 0.0, params);
         
+        // 记录完整轨迹
+        TrajectoryRecorder trajectory(binaryTrajectory ? "vehicle_trajectory.bin" : "vehicle_trajectory.csv", 1,
+                                      recorderOptions);
+        vehicle.setRecorder(&trajectory);
+
         // 设置目标控制
         vehicle.setControls(1.0, 0.0);
 
@@ -182,6 +701,8 @@ int main() {
         for (int i = 0; i < 100; ++i) {
             vehicle.update(dt);
         }
+        vehicle.setRecorder(nullptr);
+        trajectory.close();
 
         // 保存数据到 CSV 文件
         vehicle.saveToCSV("vehicle_data.csv");